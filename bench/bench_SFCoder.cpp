@@ -0,0 +1,851 @@
+#include <benchmark/benchmark.h>
+#include <SFCoder.cpp>
+#include <SFEncoder.cpp>
+#include <SFParallelDecoder.cpp>
+#include <SFFile.cpp>
+#include <SFEncoderContext.cpp>
+#include <SFDictionary.cpp>
+#include <MyMap.cpp>
+#include <BTreeMap.cpp>
+#include <LinkedList.cpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <random>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+//  Benchmark suite of the coder and the containers.
+//  The coder stages are run on every input distribution at sizes from 1 KiB
+//  up to SF_BENCH_MAX_SIZE bytes (environment variable, K, M and G suffixes
+//  allowed, 16M by default, at most 1G). Results can be written as JSON
+//  with --benchmark_out=<file> --benchmark_out_format=json, or with the
+//  bench_SFCoder_json CMake target.
+
+//  Pseudo-English text built from a fixed word list
+static std::string makeText(size_t size)
+{
+    static const char* words[] = {
+        "the", "of", "and", "to", "in", "is", "was", "that", "for", "it",
+        "with", "as", "his", "on", "be", "at", "by", "had", "this", "from",
+        "compression", "table", "symbol", "frequency", "encoder", "stream"
+    };
+    std::mt19937 rng(42);
+    std::string text;
+    text.reserve(size);
+    while (text.size() < size) {
+        text += words[rng() % (sizeof(words) / sizeof(words[0]))];
+        text += (rng() % 12 == 0) ? ".\n" : " ";
+    }
+    text.resize(size);
+    return text;
+}
+
+//  Server log lines with timestamps, levels, thread names and numbers
+static std::string makeLogs(size_t size)
+{
+    static const char* levels[] = {"INFO ", "INFO ", "INFO ", "DEBUG", "WARN ", "ERROR"};
+    static const char* events[] = {
+        "request completed", "cache miss", "connection opened", "connection closed",
+        "retrying upstream call", "slow query"
+    };
+    std::mt19937 rng(42);
+    std::string logs;
+    logs.reserve(size + 128);
+    uint64_t millis = 0;
+    char line[128];
+    while (logs.size() < size) {
+        millis += rng() % 50;
+        int length = std::snprintf(line, sizeof(line),
+                                   "2024-03-14 %02u:%02u:%02u.%03u %s [worker-%u] %s id=%u in %u ms\n",
+                                   unsigned(millis / 3600000 % 24), unsigned(millis / 60000 % 60),
+                                   unsigned(millis / 1000 % 60), unsigned(millis % 1000),
+                                   levels[rng() % 6], unsigned(rng() % 16), events[rng() % 6],
+                                   unsigned(rng() % 100000), unsigned(rng() % 500));
+        logs.append(line, length);
+    }
+    logs.resize(size);
+    return logs;
+}
+
+//  Uniformly distributed random bytes
+static std::string makeRandom(size_t size)
+{
+    std::mt19937 rng(42);
+    std::string data(size, '\0');
+    for (char& c : data) c = static_cast<char>(rng());
+    return data;
+}
+
+//  One byte value repeated
+static std::string makeSingle(size_t size)
+{
+    return std::string(size, 'a');
+}
+
+//  Bytes with a geometric distribution, each value about 1.4 times rarer
+//  than the one before, so the code lengths spread widely
+static std::string makeSkewed(size_t size)
+{
+    std::mt19937 rng(42);
+    std::geometric_distribution<int> distribution(0.3);
+    std::string data(size, '\0');
+    for (char& c : data) c = static_cast<char>(std::min(distribution(rng), 255));
+    return data;
+}
+
+//  Input distributions of the suite
+struct Distribution
+{
+    const char* name;
+    std::string (*make)(size_t);
+};
+
+static const Distribution distributions[] = {
+    {"Text", makeText}, {"Logs", makeLogs}, {"Random", makeRandom},
+    {"Single", makeSingle}, {"Skewed", makeSkewed}
+};
+
+//  Returns the input of the given distribution and size. Generating the
+//  largest inputs takes longer than running on them, so the last input is
+//  kept for the next benchmark, which usually asks for the same one.
+static const std::string& getInput(const Distribution& distribution, size_t size)
+{
+    static const Distribution* lastDistribution = nullptr;
+    static std::string last;
+    if (lastDistribution != &distribution || last.size() != size) {
+        last = std::string();
+        last = distribution.make(size);
+        lastDistribution = &distribution;
+    }
+    return last;
+}
+
+static const uint8_t* bytes(const std::string& data)
+{
+    return reinterpret_cast<const uint8_t*>(data.data());
+}
+
+//  Returns SF_BENCH_MAX_SIZE in bytes
+static size_t maxInputSize()
+{
+    const char* value = std::getenv("SF_BENCH_MAX_SIZE");
+    if (value == nullptr) {
+        return size_t(1) << 24;
+    }
+    char* suffix;
+    size_t size = std::strtoull(value, &suffix, 10);
+    switch (*suffix) {
+        case 'G': case 'g': size <<= 30; break;
+        case 'M': case 'm': size <<= 20; break;
+        case 'K': case 'k': size <<= 10; break;
+    }
+    return size;
+}
+
+//  Input sizes of the coder benchmarks: 1 KiB to 1 GiB by factors of 16,
+//  up to SF_BENCH_MAX_SIZE
+static std::vector<size_t> inputSizes()
+{
+    std::vector<size_t> sizes;
+    size_t limit = maxInputSize();
+    for (size_t size = size_t(1) << 10; size <= (size_t(1) << 30) && size <= limit; size <<= 4) {
+        sizes.push_back(size);
+    }
+    return sizes;
+}
+
+//  Counting byte frequencies
+static void histogramBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, state.range(0));
+    for (auto _ : state) {
+        ByteHistogram histogram(bytes(data), data.size());
+        benchmark::DoNotOptimize(histogram.get_counts());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+}
+
+//  Code table construction from a ready histogram of 1 MiB of input
+static void tableBuildBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, size_t(1) << 20);
+    ByteHistogram histogram(bytes(data), data.size());
+    SFTableBuilder builder;
+    SFCodeTable table;
+    for (auto _ : state) {
+        builder.build(histogram, table);
+        benchmark::DoNotOptimize(&table);
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["alphabet"] = histogram.get_alphabetSize();
+}
+
+//  Encoding only: the table is built once outside of the timed loop
+static void encodeBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, state.range(0));
+    ByteHistogram histogram(bytes(data), data.size());
+    SFTableBuilder builder;
+    SFCodeTable table;
+    builder.build(histogram, table);
+    BitWriter writer;
+    for (auto _ : state) {
+        writer.clear();
+        table.encode(bytes(data), data.size(), writer);
+        writer.finish();
+        benchmark::DoNotOptimize(writer.get_bytes().data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+    state.counters["bits_per_byte"] = double(writer.get_bitlength()) / data.size();
+}
+
+//  Decoding only, from a payload encoded outside of the timed loop
+static void decodeBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, state.range(0));
+    ByteHistogram histogram(bytes(data), data.size());
+    SFTableBuilder builder;
+    SFCodeTable table;
+    builder.build(histogram, table);
+    BitWriter writer;
+    table.encode(bytes(data), data.size(), writer);
+    writer.finish();
+
+    SFDecoder decoder(table);
+    std::vector<uint8_t> output(data.size());
+    for (auto _ : state) {
+        decoder.decode(writer.get_bytes().data(), writer.get_bytes().size(), output.data(), output.size());
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+}
+
+//  The whole in-memory SFCoder pipeline: histogram, table, encode and decode
+static void coderBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, state.range(0));
+    uint64_t bits = 0;
+    for (auto _ : state) {
+        SFCoder coder(data);
+        bits = coder.get_bitlength();
+        benchmark::DoNotOptimize(bits);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * data.size());
+    state.counters["ratio"] = double(bits) / (data.size() * 8);
+}
+
+//  The same pipeline on byte pairs coded as 16-bit symbols
+static void digramCoderBenchmark(benchmark::State& state, const Distribution& distribution)
+{
+    const std::string& data = getInput(distribution, state.range(0));
+    SFCoder16::String pairs(data.size() / 2);
+    for (size_t i = 0; i < pairs.size(); i++) {
+        pairs[i] = static_cast<uint16_t>(uint8_t(data[2 * i]) << 8 | uint8_t(data[2 * i + 1]));
+    }
+    uint64_t bits = 0;
+    for (auto _ : state) {
+        SFCoder16 coder(pairs);
+        bits = coder.get_bitlength();
+        benchmark::DoNotOptimize(bits);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * pairs.size() * 2);
+    state.counters["ratio"] = double(bits) / (pairs.size() * 16);
+}
+
+//  Registers the coder benchmarks for every distribution and input size.
+//  SFCoder counts sizes in bits in an int, so it is run up to 64 MiB only.
+//  SFCoder16 codes the input as byte pairs.
+static void registerCoderBenchmarks()
+{
+    std::vector<size_t> sizes = inputSizes();
+    for (const Distribution& distribution : distributions) {
+        std::string name = distribution.name;
+        for (size_t size : sizes) {
+            benchmark::RegisterBenchmark(("Histogram/" + name).c_str(), histogramBenchmark, distribution)
+                ->Arg(size);
+        }
+        benchmark::RegisterBenchmark(("TableBuild/" + name).c_str(), tableBuildBenchmark, distribution);
+        for (size_t size : sizes) {
+            benchmark::RegisterBenchmark(("Encode/" + name).c_str(), encodeBenchmark, distribution)
+                ->Arg(size);
+        }
+        for (size_t size : sizes) {
+            benchmark::RegisterBenchmark(("Decode/" + name).c_str(), decodeBenchmark, distribution)
+                ->Arg(size);
+        }
+        for (size_t size : sizes) {
+            if (size <= (size_t(1) << 26)) {
+                benchmark::RegisterBenchmark(("SFCoder/" + name).c_str(), coderBenchmark, distribution)
+                    ->Arg(size);
+                benchmark::RegisterBenchmark(("SFCoder16/" + name).c_str(), digramCoderBenchmark, distribution)
+                    ->Arg(size);
+            }
+        }
+    }
+}
+
+//  Short messages of 50 to 500 bytes cut from the log input
+static std::vector<SFSpan> makeMessages(const std::string& logs, size_t count)
+{
+    std::mt19937 rng(42);
+    std::vector<SFSpan> messages;
+    size_t offset = 0;
+    for (size_t i = 0; i < count; i++) {
+        size_t size = 50 + rng() % 451;
+        if (offset + size > logs.size()) offset = 0;
+        messages.push_back({bytes(logs) + offset, size});
+        offset += size;
+    }
+    return messages;
+}
+
+//  Encoding a batch of short messages against a trained dictionary
+static void BM_Dictionary_EncodeBatch(benchmark::State& state)
+{
+    std::string logs = makeLogs(size_t(1) << 22);
+    std::vector<SFSpan> messages = makeMessages(logs, state.range(0));
+    SFDictionary dictionary;
+    dictionary.train(messages.data(), messages.size() / 10);
+
+    std::vector<uint8_t> output;
+    std::vector<SFSpan> encoded;
+    size_t rawSize = 0;
+    for (const SFSpan& message : messages) rawSize += message.size;
+    for (auto _ : state) {
+        dictionary.encodeBatch(messages.data(), messages.size(), output, encoded);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * rawSize);
+    state.SetItemsProcessed(int64_t(state.iterations()) * messages.size());
+    state.counters["ratio"] = double(output.size()) / rawSize;
+}
+BENCHMARK(BM_Dictionary_EncodeBatch)->Arg(10000);
+
+//  Decoding a batch of short messages against a trained dictionary
+static void BM_Dictionary_DecodeBatch(benchmark::State& state)
+{
+    std::string logs = makeLogs(size_t(1) << 22);
+    std::vector<SFSpan> messages = makeMessages(logs, state.range(0));
+    SFDictionary dictionary;
+    dictionary.train(messages.data(), messages.size() / 10);
+
+    std::vector<uint8_t> encodedBytes, output;
+    std::vector<SFSpan> encoded, decoded;
+    dictionary.encodeBatch(messages.data(), messages.size(), encodedBytes, encoded);
+    size_t rawSize = 0;
+    for (const SFSpan& message : messages) rawSize += message.size;
+    for (auto _ : state) {
+        dictionary.decodeBatch(encoded.data(), encoded.size(), output, decoded);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * rawSize);
+    state.SetItemsProcessed(int64_t(state.iterations()) * messages.size());
+}
+BENCHMARK(BM_Dictionary_DecodeBatch)->Arg(10000);
+
+//  The same messages compressed one by one, each with its own table
+static void BM_EncoderContext_Messages(benchmark::State& state)
+{
+    std::string logs = makeLogs(size_t(1) << 22);
+    std::vector<SFSpan> messages = makeMessages(logs, state.range(0));
+    SFEncoderContext context;
+    std::vector<uint8_t> output;
+    size_t rawSize = 0, encodedSize = 0;
+    for (const SFSpan& message : messages) rawSize += message.size;
+    for (auto _ : state) {
+        encodedSize = 0;
+        for (const SFSpan& message : messages) {
+            encodedSize += context.compress(message.data, message.size, output);
+        }
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * rawSize);
+    state.SetItemsProcessed(int64_t(state.iterations()) * messages.size());
+    state.counters["ratio"] = double(encodedSize) / rawSize;
+}
+BENCHMARK(BM_EncoderContext_Messages)->Arg(10000);
+
+//  Distinct keys in random order
+static std::vector<int> makeKeys(size_t count)
+{
+    std::vector<int> keys(count);
+    std::iota(keys.begin(), keys.end(), 0);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(42));
+    return keys;
+}
+
+//  Maps with nodes from the default NodePool and from operator new, and the
+//  B+-tree with its cache-line aligned nodes
+using PoolMap = MyMap<int, int>;
+using HeapMap = MyMap<int, int, HeapNodeAllocator<TreeNode<int, int>>>;
+using BTree = BTreeMap<int, int>;
+
+//  Inserting keys in random order into an empty map
+template <typename Map>
+static void BM_MyMap_Insert(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<Map> map(new Map());
+        state.ResumeTiming();
+        for (int key : keys) map->insert(key, key);
+        state.PauseTiming();
+        map.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_MyMap_Insert, PoolMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_Insert, HeapMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_Insert, BTree)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Filling and clearing the same map, as a map rebuilt every period is used
+template <typename Map>
+static void BM_MyMap_InsertClear(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    Map map;
+    for (auto _ : state) {
+        for (int key : keys) map.insert(key, key);
+        map.clear();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_MyMap_InsertClear, PoolMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_InsertClear, HeapMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_InsertClear, BTree)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Looking up every key of the map in random order
+template <typename Map>
+static void BM_MyMap_Find(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    Map map;
+    for (int key : keys) map.insert(key, key);
+    std::shuffle(keys.begin(), keys.end(), std::mt19937(7));
+    for (auto _ : state) {
+        for (int key : keys) benchmark::DoNotOptimize(map.find(key));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK_TEMPLATE(BM_MyMap_Find, PoolMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_Find, HeapMap)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+BENCHMARK_TEMPLATE(BM_MyMap_Find, BTree)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Building a map from a sorted snapshot by inserting every pair, then by
+//  bulk loading (second argument 1)
+static void BM_MyMap_BuildSorted(benchmark::State& state)
+{
+    std::vector<std::pair<int, int>> sorted(state.range(0));
+    for (size_t i = 0; i < sorted.size(); i++) sorted[i] = {int(i), int(i)};
+    for (auto _ : state) {
+        if (state.range(1) != 0) {
+            MyMap<int, int> map(sorted.begin(), sorted.end());
+            benchmark::DoNotOptimize(map.get_size());
+        } else {
+            MyMap<int, int> map;
+            for (const auto& pair : sorted) map.insert(pair.first, pair.second);
+            benchmark::DoNotOptimize(map.get_size());
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * sorted.size());
+}
+BENCHMARK(BM_MyMap_BuildSorted)->ArgsProduct({{1 << 10, 1 << 15, 1 << 20, 1 << 22}, {0, 1}});
+
+//  Merging a sorted batch as large as the map, half of it new keys, by
+//  upserting every pair or with mergeSorted (second argument 1)
+static void BM_MyMap_MergeSorted(benchmark::State& state)
+{
+    std::vector<std::pair<int, int>> sorted(state.range(0)), batch;
+    for (size_t i = 0; i < sorted.size(); i++) sorted[i] = {int(2 * i), int(i)};
+    for (size_t i = 0; i < sorted.size(); i++) batch.push_back({int(2 * i + i % 2), 0});
+    for (auto _ : state) {
+        state.PauseTiming();
+        std::unique_ptr<MyMap<int, int>> map(new MyMap<int, int>(sorted.begin(), sorted.end()));
+        state.ResumeTiming();
+        if (state.range(1) != 0) {
+            map->mergeSorted(batch.begin(), batch.end());
+        } else {
+            for (const auto& pair : batch) map->upsert(pair.first, pair.second);
+        }
+        state.PauseTiming();
+        map.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * batch.size());
+}
+BENCHMARK(BM_MyMap_MergeSorted)->ArgsProduct({{1 << 10, 1 << 15, 1 << 20}, {0, 1}});
+
+//  Looking up keys that are not in the map
+static void BM_MyMap_HasMissing(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    MyMap<int, int> map;
+    for (int key : keys) map.insert(2 * key, key);
+    for (auto _ : state) {
+        for (int key : keys) benchmark::DoNotOptimize(map.has(2 * key + 1));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK(BM_MyMap_HasMissing)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Counting occurrences of keys, each seen about 8 times, with a lookup
+//  followed by an insert or an increment, as counting was written before
+//  the map had operator[]
+static void BM_MyMap_CountHasInsert(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    for (int& key : keys) key %= keys.size() / 8;
+    for (auto _ : state) {
+        MyMap<int, int> counts;
+        for (int key : keys) {
+            if (counts.has(key)) {
+                counts.addToValue(key, 1);
+            } else {
+                counts.insert(key, 1);
+            }
+        }
+        benchmark::DoNotOptimize(counts.lookup(0));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK(BM_MyMap_CountHasInsert)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  The same counting in a single descent per key
+static void BM_MyMap_CountUpsert(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    for (int& key : keys) key %= keys.size() / 8;
+    for (auto _ : state) {
+        MyMap<int, int> counts;
+        for (int key : keys) counts[key]++;
+        benchmark::DoNotOptimize(counts.lookup(0));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK(BM_MyMap_CountUpsert)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Collecting all keys of the map into a list. Every key is appended with
+//  LinkedList::push_back, which walks the list, so sizes stay small.
+static void BM_MyMap_Keys(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    MyMap<int, int> map;
+    for (int key : keys) map.insert(key, key);
+    for (auto _ : state) {
+        LinkedList<int> list = map.get_keys();
+        benchmark::DoNotOptimize(list.get_size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK(BM_MyMap_Keys)->RangeMultiplier(4)->Range(1 << 10, 1 << 14);
+
+//  Scanning all entries of the map in key order in place, for comparison
+//  with the copy made by get_keys()
+static void BM_MyMap_Iterate(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    MyMap<int, int> map;
+    for (int key : keys) map.insert(key, key);
+    for (auto _ : state) {
+        int64_t sum = 0;
+        for (auto entry : map) sum += entry.second;
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * keys.size());
+}
+BENCHMARK(BM_MyMap_Iterate)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Range queries of 64 consecutive keys starting at random keys
+static void BM_MyMap_RangeScan(benchmark::State& state)
+{
+    std::vector<int> keys = makeKeys(state.range(0));
+    MyMap<int, int> map;
+    for (int key : keys) map.insert(key, key);
+    size_t query = 0;
+    for (auto _ : state) {
+        int first = keys[query++ % keys.size()];
+        int64_t sum = 0;
+        auto end = map.upper_bound(first + 63);
+        for (auto it = map.lower_bound(first); it != end; ++it) sum += it.value();
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * 64);
+}
+BENCHMARK(BM_MyMap_RangeScan)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Appending to and then draining a list; push_back walks the list, so
+//  sizes stay small
+static void BM_LinkedList_PushBackPopFront(benchmark::State& state)
+{
+    int count = state.range(0);
+    for (auto _ : state) {
+        LinkedList<int> list;
+        for (int i = 0; i < count; i++) list.push_back(i);
+        while (!list.isEmpty()) list.pop_front();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(BM_LinkedList_PushBackPopFront)->RangeMultiplier(4)->Range(1 << 10, 1 << 14);
+
+//  Prepending to a list
+static void BM_LinkedList_PushFront(benchmark::State& state)
+{
+    int count = state.range(0);
+    for (auto _ : state) {
+        LinkedList<int> list;
+        for (int i = 0; i < count; i++) list.push_front(i);
+        benchmark::DoNotOptimize(list.get_size());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(BM_LinkedList_PushFront)->RangeMultiplier(32)->Range(1 << 10, 1 << 20);
+
+//  Reading random positions; at() walks the list, so sizes stay small
+static void BM_LinkedList_At(benchmark::State& state)
+{
+    int count = state.range(0);
+    LinkedList<int> list;
+    for (int i = 0; i < count; i++) list.push_back(i);
+    std::vector<int> positions = makeKeys(count);
+    for (auto _ : state) {
+        for (int position : positions) benchmark::DoNotOptimize(list.at(position));
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * count);
+}
+BENCHMARK(BM_LinkedList_At)->RangeMultiplier(4)->Range(1 << 6, 1 << 12);
+
+//  Block-parallel compression with the number of threads as the argument
+static void BM_SFEncoder_Threads(benchmark::State& state)
+{
+    std::string text = makeText(size_t(1) << 26);
+    std::vector<uint8_t> output;
+    SFOptions options;
+    options.threads = state.range(0);
+    for (auto _ : state) {
+        output.clear();
+        SFVectorSink sink(output);
+        SFEncoder encoder(sink, options);
+        encoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        encoder.finish();
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * text.size());
+}
+BENCHMARK(BM_SFEncoder_Threads)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+//  Streaming compression of logs by block size, with fixed per-block tables
+//  (second argument 0) or adaptive tables (1)
+static void BM_SFEncoder_Adaptive(benchmark::State& state)
+{
+    const std::string& logs = getInput(distributions[1], size_t(1) << 24);
+    std::vector<uint8_t> output;
+    SFOptions options;
+    options.blockSize = state.range(0);
+    options.adaptive = state.range(1) != 0;
+    for (auto _ : state) {
+        output.clear();
+        SFVectorSink sink(output);
+        SFEncoder encoder(sink, options);
+        encoder.update(bytes(logs), logs.size());
+        encoder.finish();
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * logs.size());
+    state.counters["ratio"] = double(output.size()) / logs.size();
+}
+BENCHMARK(BM_SFEncoder_Adaptive)->ArgsProduct({{1 << 12, 1 << 16, 1 << 20}, {0, 1}});
+
+//  Compression and decompression of each distribution with order-0 tables
+//  (second argument 0) or order-1 context tables (1) in 1 MiB blocks
+static void BM_SFContext_Encode(benchmark::State& state)
+{
+    const std::string& input = getInput(distributions[state.range(0)], size_t(1) << 24);
+    std::vector<uint8_t> output;
+    SFOptions options;
+    options.contextModel = state.range(1) != 0;
+    SFEncoderContext context(options);
+    for (auto _ : state) {
+        context.compress(input, output);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetLabel(distributions[state.range(0)].name);
+    state.SetBytesProcessed(int64_t(state.iterations()) * input.size());
+    state.counters["ratio"] = double(output.size()) / input.size();
+}
+BENCHMARK(BM_SFContext_Encode)->ArgsProduct({{0, 1, 2, 4}, {0, 1}});
+
+static void BM_SFContext_Decode(benchmark::State& state)
+{
+    const std::string& input = getInput(distributions[state.range(0)], size_t(1) << 24);
+    std::vector<uint8_t> encoded, output;
+    SFOptions options;
+    options.contextModel = state.range(1) != 0;
+    SFEncoderContext(options).compress(input, encoded);
+    SFStreamDecoder decoder;
+    for (auto _ : state) {
+        output.clear();
+        SFVectorSink sink(output);
+        decoder.decode(encoded.data(), encoded.size(), sink);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetLabel(distributions[state.range(0)].name);
+    state.SetBytesProcessed(int64_t(state.iterations()) * input.size());
+}
+BENCHMARK(BM_SFContext_Decode)->ArgsProduct({{0, 1, 2, 4}, {0, 1}});
+
+//  Single-threaded decompression of each distribution in 1 MiB blocks whose
+//  payloads are split into the given number of interleaved streams
+static void BM_SFInterleaved_Decode(benchmark::State& state)
+{
+    const std::string& input = getInput(distributions[state.range(0)], size_t(1) << 24);
+    std::vector<uint8_t> encoded, output;
+    SFOptions options;
+    options.streams = state.range(1);
+    SFEncoderContext(options).compress(input, encoded);
+    SFStreamDecoder decoder;
+    for (auto _ : state) {
+        output.clear();
+        SFVectorSink sink(output);
+        decoder.decode(encoded.data(), encoded.size(), sink);
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetLabel(distributions[state.range(0)].name);
+    state.SetBytesProcessed(int64_t(state.iterations()) * input.size());
+    state.counters["ratio"] = double(encoded.size()) / input.size();
+}
+BENCHMARK(BM_SFInterleaved_Decode)->ArgsProduct({{0, 1, 2, 4}, {1, 2, 4, 8}});
+
+//  Block-parallel decompression with the number of threads as the argument
+static void BM_SFParallelDecoder_Threads(benchmark::State& state)
+{
+    std::string text = makeText(size_t(1) << 26);
+    std::vector<uint8_t> encoded;
+    SFVectorSink sink(encoded);
+    SFEncoder encoder(sink);
+    encoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    encoder.finish();
+
+    SFParallelDecoder decoder(state.range(0));
+    std::vector<uint8_t> output(text.size());
+    for (auto _ : state) {
+        decoder.decode(encoded.data(), encoded.size(), output.data(), output.size());
+        benchmark::DoNotOptimize(output.data());
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * text.size());
+}
+BENCHMARK(BM_SFParallelDecoder_Threads)->RangeMultiplier(2)->Range(1, 32)->UseRealTime();
+
+//  Writes size bytes of pseudo-English text to path, a chunk at a time
+static void writeTextFile(const std::string& path, size_t size)
+{
+    const size_t CHUNK = size_t(1) << 24;
+    std::string chunk = makeText(CHUNK);
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    for (size_t written = 0; written < size; written += CHUNK) {
+        output.write(chunk.data(), size - written < CHUNK ? size - written : CHUNK);
+    }
+}
+
+//  Runs work in a child process and returns the child's peak resident set
+//  size in MiB, so the figure is not inflated by what the benchmark process
+//  itself has allocated. Returns 0 where fork is not available.
+static double childPeakRSS(const std::function<void()>& work)
+{
+#ifdef _WIN32
+    (void)work;
+    return 0;
+#else
+    pid_t child = fork();
+    if (child == 0) {
+        work();
+        _exit(0);
+    }
+    int status;
+    struct rusage usage;
+    wait4(child, &status, 0, &usage);
+    return usage.ru_maxrss / 1024.0;
+#endif
+}
+
+//  File to file compression through the memory-mapped path. Reports the
+//  input size and the peak RSS of a separate compressing process.
+static void BM_CompressFile(benchmark::State& state)
+{
+    std::string original = "bench_original.txt";
+    std::string compressed = "bench_compressed.sfc";
+    writeTextFile(original, state.range(0));
+    for (auto _ : state) {
+        compressFile(original, compressed);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+    state.counters["input_MiB"] = state.range(0) / 1048576.0;
+    state.counters["peakRSS_MiB"] = childPeakRSS([&]() { compressFile(original, compressed); });
+    std::remove(original.c_str());
+    std::remove(compressed.c_str());
+}
+BENCHMARK(BM_CompressFile)->Arg(1 << 26)->Arg(1 << 28)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//  File to file decompression through the memory-mapped path
+static void BM_DecompressFile(benchmark::State& state)
+{
+    std::string original = "bench_original.txt";
+    std::string compressed = "bench_compressed.sfc";
+    std::string restored = "bench_restored.txt";
+    writeTextFile(original, state.range(0));
+    compressFile(original, compressed);
+    for (auto _ : state) {
+        decompressFile(compressed, restored);
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+    state.counters["input_MiB"] = state.range(0) / 1048576.0;
+    state.counters["peakRSS_MiB"] = childPeakRSS([&]() { decompressFile(compressed, restored); });
+    std::remove(original.c_str());
+    std::remove(compressed.c_str());
+    std::remove(restored.c_str());
+}
+BENCHMARK(BM_DecompressFile)->Arg(1 << 26)->Arg(1 << 28)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+//  The same file read whole into a string and compressed with SFCoder, for
+//  comparison of peak RSS
+static void BM_SFCoder_File(benchmark::State& state)
+{
+    std::string original = "bench_original.txt";
+    writeTextFile(original, state.range(0));
+    auto work = [&]() {
+        std::ifstream input(original, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        SFCoder coder(text);
+        benchmark::DoNotOptimize(coder.get_bitlength());
+    };
+    for (auto _ : state) {
+        work();
+    }
+    state.SetBytesProcessed(int64_t(state.iterations()) * state.range(0));
+    state.counters["input_MiB"] = state.range(0) / 1048576.0;
+    state.counters["peakRSS_MiB"] = childPeakRSS(work);
+    std::remove(original.c_str());
+}
+BENCHMARK(BM_SFCoder_File)->Arg(1 << 26)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+int main(int argc, char** argv)
+{
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    registerCoderBenchmarks();
+    benchmark::AddCustomContext("sf_bench_max_size", std::to_string(maxInputSize()));
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
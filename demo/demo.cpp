@@ -1,6 +1,24 @@
 #include <SFCoder.cpp>
+#include <SFFile.cpp>
+#include <cstring>
+
+int main(int argc, char* argv[]) {
+    //  demo -c <input> <output> compresses a file, demo -d <input> <output>
+    //  restores it
+    if (argc == 4 && (std::strcmp(argv[1], "-c") == 0 || std::strcmp(argv[1], "-d") == 0)) {
+        try {
+            if (argv[1][1] == 'c') {
+                compressFile(argv[2], argv[3]);
+            } else {
+                decompressFile(argv[2], argv[3]);
+            }
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << '\n';
+            return 1;
+        }
+        return 0;
+    }
 
-int main() {
     std::string text;
     std::cout << "Enter text:\n";
     std::getline(std::cin, text);
@@ -13,4 +31,4 @@ int main() {
     std::cout << "\nDecoded string:\n" << mySFCode.get_decoded();
     mySFCode.print_ftable();
     system("pause");
-}
\ No newline at end of file
+}
@@ -0,0 +1,727 @@
+#ifndef BTreeMap_H
+#define BTreeMap_H
+
+#include <algorithm>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <LinkedList.cpp>
+#include <NodePool.cpp>
+
+//  Ordered map on a B+-tree, with the interface of MyMap, so either one can
+//  be chosen by a type alias. Every node spans NODE_BYTES, a few cache
+//  lines, aligned to a cache line: inner nodes hold up to INNER_CAPACITY
+//  separator keys and their children, leaves up to LEAF_CAPACITY entries
+//  and links to the leaves next to them. A lookup then reads a handful of
+//  nodes where the red-black tree chases a pointer, and likely misses the
+//  cache, for every level.
+//  The separator before child i + 1 is no greater than any key of that
+//  child and greater than every key of child i. Nodes are split on the way
+//  down when full and refilled from or merged with a sibling on the way up
+//  when less than half full. Entries move between nodes, so unlike MyMap
+//  any insert or remove invalidates iterators and pointers to values.
+//  Nodes come from two NodePools owned by the map.
+template <typename Key, typename Value>
+class BTreeMap
+{
+    public:
+        static constexpr size_t CACHE_LINE = 64;
+        static constexpr size_t NODE_BYTES = 4 * CACHE_LINE;
+        static constexpr size_t LEAF_CAPACITY =
+            std::max<size_t>(4, (NODE_BYTES - 3 * sizeof(void*)) / (sizeof(Key) + sizeof(Value)));
+        static constexpr size_t INNER_CAPACITY =
+            std::max<size_t>(4, (NODE_BYTES - 2 * sizeof(void*)) / (sizeof(Key) + sizeof(void*)));
+
+    private:
+        struct alignas(CACHE_LINE) Leaf
+        {
+            Key keys[LEAF_CAPACITY];
+            Value values[LEAF_CAPACITY];
+            Leaf* previous;
+            Leaf* next;
+            size_t count;
+        };
+
+        struct alignas(CACHE_LINE) Inner
+        {
+            Key keys[INNER_CAPACITY];
+            void* children[INNER_CAPACITY + 1];
+            size_t count;
+        };
+
+        template <bool Const>
+        class Iterator
+        {
+            friend class BTreeMap;
+            template <bool> friend class Iterator;
+
+            public:
+                using MappedRef = typename std::conditional<Const, const Value&, Value&>::type;
+                using iterator_category = std::bidirectional_iterator_tag;
+                using value_type = std::pair<const Key, Value>;
+                using difference_type = std::ptrdiff_t;
+                using reference = std::pair<const Key&, MappedRef>;
+
+                struct pointer
+                {
+                    reference entry;
+                    const reference* operator->() const { return &entry; }
+                };
+
+                Iterator() : map(nullptr), leaf(nullptr), index(0) {}
+                template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+                Iterator(const Iterator<OtherConst>& other) : map(other.map), leaf(other.leaf), index(other.index) {}
+
+                reference operator*() const { return reference(leaf->keys[index], leaf->values[index]); }
+                pointer operator->() const { return pointer{**this}; }
+                const Key& key() const { return leaf->keys[index]; }
+                MappedRef value() const { return leaf->values[index]; }
+
+                Iterator& operator++()
+                {
+                    if (++index == leaf->count) {
+                        leaf = leaf->next;
+                        index = 0;
+                    }
+                    return *this;
+                }
+                Iterator& operator--()
+                {
+                    if (leaf == nullptr || index == 0) {
+                        leaf = leaf == nullptr ? map->last : leaf->previous;
+                        index = leaf->count;
+                    }
+                    index--;
+                    return *this;
+                }
+                Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+                Iterator operator--(int) { Iterator old = *this; --*this; return old; }
+
+                bool operator==(const Iterator& other) const { return leaf == other.leaf && index == other.index; }
+                bool operator!=(const Iterator& other) const { return !(*this == other); }
+
+            private:
+                const BTreeMap* map;
+                Leaf* leaf;
+                size_t index;
+
+                //  position index of leaf, or the end if it is past the last entry
+                Iterator(const BTreeMap* map, Leaf* leaf, size_t index) : map(map), leaf(leaf), index(index)
+                {
+                    if (leaf != nullptr && index == leaf->count) {
+                        this->leaf = leaf->next;
+                        this->index = 0;
+                    }
+                }
+        };
+
+    public:
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
+        BTreeMap();
+        BTreeMap(std::initializer_list<std::pair<Key, Value>> initList);
+        BTreeMap(const BTreeMap&) = delete;
+        BTreeMap& operator=(const BTreeMap&) = delete;
+        ~BTreeMap();
+
+        void insert(Key key, Value value);
+        Value& upsert(Key key, Value value);
+        Value& operator[](Key key);
+        void remove(Key key);
+        Value find(Key key) const;
+        Value* lookup(Key key);
+        const Value* lookup(Key key) const;
+        bool has(Key key) const;
+        void addToValue(Key key, int add);
+        size_t get_size() const;
+        void clear();
+        LinkedList<Key> get_keys() const;
+        LinkedList<Value> get_values() const;
+
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+        iterator lower_bound(const Key& key);
+        iterator upper_bound(const Key& key);
+        std::pair<iterator, iterator> equal_range(const Key& key);
+        const_iterator lower_bound(const Key& key) const;
+        const_iterator upper_bound(const Key& key) const;
+        std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+
+    private:
+        static constexpr size_t LEAF_MINIMUM = LEAF_CAPACITY / 2;
+        static constexpr size_t INNER_MINIMUM = INNER_CAPACITY / 2;
+
+        void* root;         // a Leaf if height is 1, an Inner above
+        unsigned height;    // levels of the tree, 0 when it is empty
+        size_t size;
+        Leaf* first;
+        Leaf* last;
+        NodePool<Leaf> leaves;
+        NodePool<Inner> inners;
+
+        Leaf* findLeaf(const Key& key) const;
+        Value* findValue(const Key& key) const;
+        Value* locate(const Key& key, const Value& value, bool& inserted);
+        void splitChild(Inner* parent, size_t i, bool leafChild);
+        bool removeFrom(void* node, unsigned level, const Key& key);
+        void rebalance(Inner* parent, size_t i, bool leafChild);
+        void mergeLeaves(Inner* parent, size_t i);
+        void mergeInners(Inner* parent, size_t i);
+        Leaf* createLeaf();
+        Inner* createInner();
+        void destroyLeaf(Leaf* leaf);
+        void destroyInner(Inner* inner);
+        void destroyRecursive(void* node, unsigned level);
+};
+
+
+template <typename Key, typename Value>
+BTreeMap<Key, Value>::BTreeMap()
+{
+    root = nullptr;
+    height = 0;
+    size = 0;
+    first = nullptr;
+    last = nullptr;
+}
+
+template <typename Key, typename Value>
+BTreeMap<Key, Value>::BTreeMap(std::initializer_list<std::pair<Key, Value>> initList) : BTreeMap()
+{
+    for (auto pair : initList) {
+        insert(pair.first, pair.second);
+    }
+}
+
+template <typename Key, typename Value>
+BTreeMap<Key, Value>::~BTreeMap()
+{
+    clear();
+}
+
+//  Inserts the key with the given value. Throws invalid_argument if the key
+//  is already in the map.
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::insert(Key key, Value value)
+{
+    bool inserted;
+    locate(key, value, inserted);
+    if (!inserted) {
+        throw std::invalid_argument("No duplicates allowed");
+    }
+}
+
+//  Sets the value of the given key, inserting the key if it is missing, in a
+//  single descent, and returns a reference to the stored value
+template <typename Key, typename Value>
+Value& BTreeMap<Key, Value>::upsert(Key key, Value value)
+{
+    bool inserted;
+    Value* stored = locate(key, value, inserted);
+    if (!inserted) {
+        *stored = value;
+    }
+    return *stored;
+}
+
+//  Returns a reference to the value of the given key, inserting the key with
+//  a default value if it is missing
+template <typename Key, typename Value>
+Value& BTreeMap<Key, Value>::operator[](Key key)
+{
+    bool inserted;
+    return *locate(key, Value(), inserted);
+}
+
+//  Removes the given key. Throws invalid_argument if it is not in the map.
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::remove(Key key)
+{
+    if (root == nullptr || !removeFrom(root, height, key)) {
+        throw std::invalid_argument("Key not found");
+    }
+    size--;
+    if (height > 1 && static_cast<Inner*>(root)->count == 0) {
+        Inner* top = static_cast<Inner*>(root);
+        root = top->children[0];
+        height--;
+        destroyInner(top);
+    } else if (height == 1 && static_cast<Leaf*>(root)->count == 0) {
+        destroyLeaf(static_cast<Leaf*>(root));
+        root = nullptr;
+        height = 0;
+        first = nullptr;
+        last = nullptr;
+    }
+}
+
+//  Returns the value of the given key. Throws invalid_argument if it is not
+//  in the map.
+template <typename Key, typename Value>
+Value BTreeMap<Key, Value>::find(Key key) const
+{
+    Value* value = findValue(key);
+    if (value == nullptr) {
+        throw std::invalid_argument("Key not found");
+    }
+    return *value;
+}
+
+//  Returns a pointer to the value of the given key, or nullptr if the key is
+//  missing; the pointer stays valid until the next insert or remove
+template <typename Key, typename Value>
+Value* BTreeMap<Key, Value>::lookup(Key key)
+{
+    return findValue(key);
+}
+
+template <typename Key, typename Value>
+const Value* BTreeMap<Key, Value>::lookup(Key key) const
+{
+    return findValue(key);
+}
+
+template <typename Key, typename Value>
+bool BTreeMap<Key, Value>::has(Key key) const
+{
+    return findValue(key) != nullptr;
+}
+
+//  Adds add to the value of the given key, if the key is present
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::addToValue(Key key, int add)
+{
+    Value* value = findValue(key);
+    if (value != nullptr) {
+        *value += add;
+    }
+}
+
+//  Returns the number of keys in the map
+template <typename Key, typename Value>
+size_t BTreeMap<Key, Value>::get_size() const
+{
+    return size;
+}
+
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::clear()
+{
+    //  nodes that need no destructor go back to the pools all at once
+    if (!std::is_trivially_destructible<Leaf>::value || !std::is_trivially_destructible<Inner>::value) {
+        destroyRecursive(root, height);
+    }
+    leaves.release();
+    inners.release();
+    root = nullptr;
+    height = 0;
+    size = 0;
+    first = nullptr;
+    last = nullptr;
+}
+
+//  Returns the list of keys in key order
+template <typename Key, typename Value>
+LinkedList<Key> BTreeMap<Key, Value>::get_keys() const
+{
+    LinkedList<Key> result = {};
+    for (auto entry : *this) {
+        result.push_back(entry.first);
+    }
+    return result;
+}
+
+//  Returns the list of values in key order
+template <typename Key, typename Value>
+LinkedList<Value> BTreeMap<Key, Value>::get_values() const
+{
+    LinkedList<Value> result = {};
+    for (auto entry : *this) {
+        result.push_back(entry.second);
+    }
+    return result;
+}
+
+//  Returns an iterator to the smallest key
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::iterator BTreeMap<Key, Value>::begin()
+{
+    return iterator(this, first, 0);
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::iterator BTreeMap<Key, Value>::end()
+{
+    return iterator(this, nullptr, 0);
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::const_iterator BTreeMap<Key, Value>::begin() const
+{
+    return const_iterator(this, first, 0);
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::const_iterator BTreeMap<Key, Value>::end() const
+{
+    return const_iterator(this, nullptr, 0);
+}
+
+//  Returns an iterator to the first key not less than the given one
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::iterator BTreeMap<Key, Value>::lower_bound(const Key& key)
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == nullptr) {
+        return end();
+    }
+    return iterator(this, leaf, std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+}
+
+//  Returns an iterator to the first key greater than the given one
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::iterator BTreeMap<Key, Value>::upper_bound(const Key& key)
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == nullptr) {
+        return end();
+    }
+    return iterator(this, leaf, std::upper_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys);
+}
+
+//  Returns the range of entries with the given key, empty or of one entry
+template <typename Key, typename Value>
+std::pair<typename BTreeMap<Key, Value>::iterator, typename BTreeMap<Key, Value>::iterator>
+BTreeMap<Key, Value>::equal_range(const Key& key)
+{
+    return {lower_bound(key), upper_bound(key)};
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::const_iterator BTreeMap<Key, Value>::lower_bound(const Key& key) const
+{
+    return const_cast<BTreeMap*>(this)->lower_bound(key);
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::const_iterator BTreeMap<Key, Value>::upper_bound(const Key& key) const
+{
+    return const_cast<BTreeMap*>(this)->upper_bound(key);
+}
+
+template <typename Key, typename Value>
+std::pair<typename BTreeMap<Key, Value>::const_iterator, typename BTreeMap<Key, Value>::const_iterator>
+BTreeMap<Key, Value>::equal_range(const Key& key) const
+{
+    return {lower_bound(key), upper_bound(key)};
+}
+
+//  Returns the leaf the given key belongs in, or nullptr if the map is empty
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::Leaf* BTreeMap<Key, Value>::findLeaf(const Key& key) const
+{
+    void* node = root;
+    for (unsigned level = height; level > 1; level--) {
+        Inner* inner = static_cast<Inner*>(node);
+        node = inner->children[std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys];
+    }
+    return static_cast<Leaf*>(node);
+}
+
+//  Returns the value of the given key, or nullptr
+template <typename Key, typename Value>
+Value* BTreeMap<Key, Value>::findValue(const Key& key) const
+{
+    Leaf* leaf = findLeaf(key);
+    if (leaf == nullptr) {
+        return nullptr;
+    }
+    size_t i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+    if (i == leaf->count || key < leaf->keys[i]) {
+        return nullptr;
+    }
+    return &leaf->values[i];
+}
+
+//  Returns the value of the given key, or inserts the key with the given
+//  value and returns that. Full nodes on the path are split on the way
+//  down, so the leaf always has room and no split goes back up.
+template <typename Key, typename Value>
+Value* BTreeMap<Key, Value>::locate(const Key& key, const Value& value, bool& inserted)
+{
+    if (root == nullptr) {
+        Leaf* leaf = createLeaf();
+        root = leaf;
+        height = 1;
+        first = leaf;
+        last = leaf;
+    }
+    bool rootFull = height == 1 ? static_cast<Leaf*>(root)->count == LEAF_CAPACITY
+                                : static_cast<Inner*>(root)->count == INNER_CAPACITY;
+    if (rootFull) {
+        Inner* top = createInner();
+        top->children[0] = root;
+        root = top;
+        splitChild(top, 0, height == 1);
+        height++;
+    }
+
+    void* node = root;
+    for (unsigned level = height; level > 1; level--) {
+        Inner* inner = static_cast<Inner*>(node);
+        size_t i = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+        bool leafChild = level == 2;
+        bool childFull = leafChild ? static_cast<Leaf*>(inner->children[i])->count == LEAF_CAPACITY
+                                   : static_cast<Inner*>(inner->children[i])->count == INNER_CAPACITY;
+        if (childFull) {
+            splitChild(inner, i, leafChild);
+            if (!(key < inner->keys[i])) {
+                i++;
+            }
+        }
+        node = inner->children[i];
+    }
+
+    Leaf* leaf = static_cast<Leaf*>(node);
+    size_t i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+    if (i < leaf->count && !(key < leaf->keys[i])) {
+        inserted = false;
+        return &leaf->values[i];
+    }
+    std::move_backward(leaf->keys + i, leaf->keys + leaf->count, leaf->keys + leaf->count + 1);
+    std::move_backward(leaf->values + i, leaf->values + leaf->count, leaf->values + leaf->count + 1);
+    leaf->keys[i] = key;
+    leaf->values[i] = value;
+    leaf->count++;
+    size++;
+    inserted = true;
+    return &leaf->values[i];
+}
+
+//  Splits the full child i of parent in two halves and adds the separator
+//  of the new right half to parent, which must not be full
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::splitChild(Inner* parent, size_t i, bool leafChild)
+{
+    void* right;
+    Key separator;
+    if (leafChild) {
+        Leaf* left = static_cast<Leaf*>(parent->children[i]);
+        Leaf* half = createLeaf();
+        size_t middle = left->count / 2;
+        std::move(left->keys + middle, left->keys + left->count, half->keys);
+        std::move(left->values + middle, left->values + left->count, half->values);
+        half->count = left->count - middle;
+        left->count = middle;
+        half->previous = left;
+        half->next = left->next;
+        if (half->next != nullptr) {
+            half->next->previous = half;
+        } else {
+            last = half;
+        }
+        left->next = half;
+        separator = half->keys[0];
+        right = half;
+    } else {
+        Inner* left = static_cast<Inner*>(parent->children[i]);
+        Inner* half = createInner();
+        size_t middle = left->count / 2;
+        separator = left->keys[middle];
+        std::move(left->keys + middle + 1, left->keys + left->count, half->keys);
+        std::copy(left->children + middle + 1, left->children + left->count + 1, half->children);
+        half->count = left->count - middle - 1;
+        left->count = middle;
+        right = half;
+    }
+    std::move_backward(parent->keys + i, parent->keys + parent->count, parent->keys + parent->count + 1);
+    std::copy_backward(parent->children + i + 1, parent->children + parent->count + 1,
+                       parent->children + parent->count + 2);
+    parent->keys[i] = separator;
+    parent->children[i + 1] = right;
+    parent->count++;
+}
+
+//  Removes the key from the subtree of node, whose level is 1 for leaves,
+//  and refills the child it was removed from if that child is now less than
+//  half full. Returns false if the key is not in the subtree.
+template <typename Key, typename Value>
+bool BTreeMap<Key, Value>::removeFrom(void* node, unsigned level, const Key& key)
+{
+    if (level == 1) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        size_t i = std::lower_bound(leaf->keys, leaf->keys + leaf->count, key) - leaf->keys;
+        if (i == leaf->count || key < leaf->keys[i]) {
+            return false;
+        }
+        std::move(leaf->keys + i + 1, leaf->keys + leaf->count, leaf->keys + i);
+        std::move(leaf->values + i + 1, leaf->values + leaf->count, leaf->values + i);
+        leaf->count--;
+        return true;
+    }
+
+    Inner* inner = static_cast<Inner*>(node);
+    size_t i = std::upper_bound(inner->keys, inner->keys + inner->count, key) - inner->keys;
+    if (!removeFrom(inner->children[i], level - 1, key)) {
+        return false;
+    }
+    bool leafChild = level == 2;
+    bool underflow = leafChild ? static_cast<Leaf*>(inner->children[i])->count < LEAF_MINIMUM
+                               : static_cast<Inner*>(inner->children[i])->count < INNER_MINIMUM;
+    if (underflow) {
+        rebalance(inner, i, leafChild);
+    }
+    return true;
+}
+
+//  Refills child i of parent with an entry of a sibling that can spare one,
+//  or else merges it with a sibling
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::rebalance(Inner* parent, size_t i, bool leafChild)
+{
+    if (leafChild) {
+        Leaf* child = static_cast<Leaf*>(parent->children[i]);
+        Leaf* left = i > 0 ? static_cast<Leaf*>(parent->children[i - 1]) : nullptr;
+        Leaf* right = i < parent->count ? static_cast<Leaf*>(parent->children[i + 1]) : nullptr;
+        if (left != nullptr && left->count > LEAF_MINIMUM) {
+            std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+            std::move_backward(child->values, child->values + child->count, child->values + child->count + 1);
+            left->count--;
+            child->keys[0] = std::move(left->keys[left->count]);
+            child->values[0] = std::move(left->values[left->count]);
+            child->count++;
+            parent->keys[i - 1] = child->keys[0];
+        } else if (right != nullptr && right->count > LEAF_MINIMUM) {
+            child->keys[child->count] = std::move(right->keys[0]);
+            child->values[child->count] = std::move(right->values[0]);
+            child->count++;
+            std::move(right->keys + 1, right->keys + right->count, right->keys);
+            std::move(right->values + 1, right->values + right->count, right->values);
+            right->count--;
+            parent->keys[i] = right->keys[0];
+        } else {
+            mergeLeaves(parent, left != nullptr ? i - 1 : i);
+        }
+        return;
+    }
+
+    Inner* child = static_cast<Inner*>(parent->children[i]);
+    Inner* left = i > 0 ? static_cast<Inner*>(parent->children[i - 1]) : nullptr;
+    Inner* right = i < parent->count ? static_cast<Inner*>(parent->children[i + 1]) : nullptr;
+    if (left != nullptr && left->count > INNER_MINIMUM) {
+        //  the separator comes down in front, the last key of left goes up
+        std::move_backward(child->keys, child->keys + child->count, child->keys + child->count + 1);
+        std::copy_backward(child->children, child->children + child->count + 1,
+                           child->children + child->count + 2);
+        child->keys[0] = std::move(parent->keys[i - 1]);
+        child->children[0] = left->children[left->count];
+        child->count++;
+        left->count--;
+        parent->keys[i - 1] = std::move(left->keys[left->count]);
+    } else if (right != nullptr && right->count > INNER_MINIMUM) {
+        child->keys[child->count] = std::move(parent->keys[i]);
+        child->children[child->count + 1] = right->children[0];
+        child->count++;
+        parent->keys[i] = std::move(right->keys[0]);
+        std::move(right->keys + 1, right->keys + right->count, right->keys);
+        std::copy(right->children + 1, right->children + right->count + 1, right->children);
+        right->count--;
+    } else {
+        mergeInners(parent, left != nullptr ? i - 1 : i);
+    }
+}
+
+//  Moves the entries of leaf i + 1 of parent into leaf i and drops it
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::mergeLeaves(Inner* parent, size_t i)
+{
+    Leaf* left = static_cast<Leaf*>(parent->children[i]);
+    Leaf* right = static_cast<Leaf*>(parent->children[i + 1]);
+    std::move(right->keys, right->keys + right->count, left->keys + left->count);
+    std::move(right->values, right->values + right->count, left->values + left->count);
+    left->count += right->count;
+    left->next = right->next;
+    if (left->next != nullptr) {
+        left->next->previous = left;
+    } else {
+        last = left;
+    }
+    destroyLeaf(right);
+
+    std::move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+    std::copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+    parent->count--;
+}
+
+//  Moves the separator i and the contents of child i + 1 of parent into
+//  child i and drops it
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::mergeInners(Inner* parent, size_t i)
+{
+    Inner* left = static_cast<Inner*>(parent->children[i]);
+    Inner* right = static_cast<Inner*>(parent->children[i + 1]);
+    left->keys[left->count] = std::move(parent->keys[i]);
+    std::move(right->keys, right->keys + right->count, left->keys + left->count + 1);
+    std::copy(right->children, right->children + right->count + 1, left->children + left->count + 1);
+    left->count += right->count + 1;
+    destroyInner(right);
+
+    std::move(parent->keys + i + 1, parent->keys + parent->count, parent->keys + i);
+    std::copy(parent->children + i + 2, parent->children + parent->count + 1, parent->children + i + 1);
+    parent->count--;
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::Leaf* BTreeMap<Key, Value>::createLeaf()
+{
+    Leaf* leaf = new (leaves.allocate()) Leaf;
+    leaf->previous = nullptr;
+    leaf->next = nullptr;
+    leaf->count = 0;
+    return leaf;
+}
+
+template <typename Key, typename Value>
+typename BTreeMap<Key, Value>::Inner* BTreeMap<Key, Value>::createInner()
+{
+    Inner* inner = new (inners.allocate()) Inner;
+    inner->count = 0;
+    return inner;
+}
+
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::destroyLeaf(Leaf* leaf)
+{
+    leaf->~Leaf();
+    leaves.deallocate(leaf);
+}
+
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::destroyInner(Inner* inner)
+{
+    inner->~Inner();
+    inners.deallocate(inner);
+}
+
+template <typename Key, typename Value>
+void BTreeMap<Key, Value>::destroyRecursive(void* node, unsigned level)
+{
+    if (level == 1) {
+        destroyLeaf(static_cast<Leaf*>(node));
+    } else if (level > 1) {
+        Inner* inner = static_cast<Inner*>(node);
+        for (size_t i = 0; i <= inner->count; i++) {
+            destroyRecursive(inner->children[i], level - 1);
+        }
+        destroyInner(inner);
+    }
+}
+
+#endif
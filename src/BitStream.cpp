@@ -0,0 +1,211 @@
+#ifndef BitStream_H
+#define BitStream_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+//  Packs variable-length codes MSB-first into a contiguous byte buffer.
+//  Bits are collected in a 64-bit accumulator and flushed as whole bytes, so
+//  the payload only ever grows by complete bytes; the last partial byte is
+//  padded with zeroes by finish().
+class BitWriter
+{
+    public:
+        BitWriter();
+
+        void write(uint64_t bits, unsigned count);
+        void finish();
+        void clear();
+
+        const std::vector<uint8_t>& get_bytes() const;
+        uint64_t get_bitlength() const;
+
+    private:
+        std::vector<uint8_t> bytes;
+        uint64_t accumulator;
+        unsigned accumulatorBits;
+        uint64_t bitLength;
+
+        void flushBytes();
+};
+
+//  Reads bits MSB-first from a packed byte buffer written by BitWriter.
+//  Up to 57 bits can be peeked at once; reading past the end of the buffer
+//  yields zero bits.
+class BitReader
+{
+    public:
+        BitReader();
+        BitReader(const uint8_t* data, size_t size);
+
+        uint64_t peek(unsigned count);
+        void consume(unsigned count);
+        uint64_t read(unsigned count);
+        uint64_t get_bitposition() const;
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t position;
+        uint64_t buffer;
+        unsigned bufferBits;
+
+        void refill();
+};
+
+
+BitWriter::BitWriter()
+{
+    accumulator = 0;
+    accumulatorBits = 0;
+    bitLength = 0;
+}
+
+//  Appends the lowest count bits of the given value, most significant first.
+//      bits    -   code to append, right-aligned
+//      count   -   number of bits to append, at most 64
+void BitWriter::write(uint64_t bits, unsigned count)
+{
+    if (count > 32) {
+        write(bits >> 32, count - 32);
+        count = 32;
+    }
+    if (count == 0) {
+        return;
+    }
+    if (accumulatorBits + count > 64) {
+        flushBytes();
+    }
+    bits &= (~0ull) >> (64 - count);
+    accumulator = (accumulatorBits == 0) ? bits : (accumulator << count) | bits;
+    accumulatorBits += count;
+    bitLength += count;
+}
+
+//  Flushes the pending bits, padding the last byte with zeroes.
+void BitWriter::finish()
+{
+    flushBytes();
+    if (accumulatorBits > 0) {
+        bytes.push_back(static_cast<uint8_t>(accumulator << (8 - accumulatorBits)));
+        accumulator = 0;
+        accumulatorBits = 0;
+    }
+}
+
+//  Drops all written bits, keeping the allocated capacity.
+void BitWriter::clear()
+{
+    bytes.clear();
+    accumulator = 0;
+    accumulatorBits = 0;
+    bitLength = 0;
+}
+
+//  Returns the packed bytes; the trailing partial byte appears only after
+//  finish().
+const std::vector<uint8_t>& BitWriter::get_bytes() const
+{
+    return bytes;
+}
+
+//  Returns the exact number of bits written.
+uint64_t BitWriter::get_bitlength() const
+{
+    return bitLength;
+}
+
+void BitWriter::flushBytes()
+{
+    while (accumulatorBits >= 8) {
+        accumulatorBits -= 8;
+        bytes.push_back(static_cast<uint8_t>(accumulator >> accumulatorBits));
+    }
+}
+
+
+//  Creates a reader of no data, to be assigned a real one later
+BitReader::BitReader() : BitReader(nullptr, 0)
+{
+}
+
+BitReader::BitReader(const uint8_t* data, size_t size)
+{
+    this->data = data;
+    this->size = size;
+    position = 0;
+    buffer = 0;
+    bufferBits = 0;
+    refill();
+}
+
+//  Returns the next count bits without consuming them.
+//      count   -   number of bits, from 1 to 57
+uint64_t BitReader::peek(unsigned count)
+{
+    if (bufferBits < count) {
+        refill();
+    }
+    return buffer >> (64 - count);
+}
+
+//  Skips count bits, which must have been peeked before, so the buffer
+//  holds at least count bits and count is below 64.
+void BitReader::consume(unsigned count)
+{
+    buffer <<= count;
+    bufferBits -= count;
+}
+
+//  Reads and consumes the next count bits.
+//      count   -   number of bits, from 0 to 64
+uint64_t BitReader::read(unsigned count)
+{
+    if (count == 0) {
+        return 0;
+    }
+    if (count > 32) {
+        uint64_t high = read(count - 32);
+        return (high << 32) | read(32);
+    }
+    uint64_t result = peek(count);
+    consume(count);
+    return result;
+}
+
+//  Returns the number of bits consumed so far: every refill advances
+//  position by the bytes it adds to the buffer
+uint64_t BitReader::get_bitposition() const
+{
+    return uint64_t(position) * 8 - bufferBits;
+}
+
+//  Tops the buffer up to at least 57 bits, shifting in zeroes past the end
+//  of data. Away from the end, eight bytes are loaded at once; the bits of
+//  the bytes that do not fit whole are loaded again by the next refill, and
+//  as they are the same bits, OR-ing them in twice does no harm.
+void BitReader::refill()
+{
+    if (position + 8 <= size) {
+        const uint8_t* bytes = data + position;
+        uint64_t word = 0;
+        for (int i = 0; i < 8; i++) {
+            word = (word << 8) | bytes[i];
+        }
+        buffer |= word >> bufferBits;
+        unsigned take = (64 - bufferBits) / 8;
+        position += take;
+        bufferBits += 8 * take;
+        return;
+    }
+    while (bufferBits <= 56) {
+        if (position < size) {
+            buffer |= static_cast<uint64_t>(data[position]) << (56 - bufferBits);
+        }
+        ++position;
+        bufferBits += 8;
+    }
+}
+
+#endif
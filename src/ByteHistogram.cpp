@@ -0,0 +1,214 @@
+#ifndef ByteHistogram_H
+#define ByteHistogram_H
+
+#include <SymbolTraits.cpp>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+//  Frequency table of the values of a symbol type, see SymbolTraits.
+//  Bytes are counted over LANES interleaved sub-histograms so consecutive
+//  equal bytes do not wait on each other's increments; the lanes are summed
+//  when counting finishes. Wider symbols are counted straight into the
+//  totals, as lanes of 65536 entries would not fit in L1 anyway.
+template <typename Symbol>
+class SymbolHistogram
+{
+    public:
+        static constexpr size_t ALPHABET_SIZE = SymbolTraits<Symbol>::ALPHABET_SIZE;
+        static constexpr unsigned LANES = 4;
+        static constexpr size_t PARALLEL_MIN_SIZE = size_t(1) << 22;
+
+        SymbolHistogram();
+        SymbolHistogram(const Symbol* data, size_t size, unsigned threads = 1);
+
+        void add(const Symbol* data, size_t size, unsigned threads = 1);
+        void add(const SymbolHistogram& other);
+        void add(Symbol symbol, uint64_t count);
+        void scale(double factor);
+        void clear();
+
+        uint64_t get_count(Symbol symbol) const;
+        const uint64_t* get_counts() const;
+        uint64_t get_total() const;
+        size_t get_alphabetSize() const;
+
+    private:
+        SymbolArray<uint64_t, ALPHABET_SIZE> counts;
+        uint64_t total;
+
+        void count(const Symbol* data, size_t size);
+        void countBytes(const uint8_t* data, size_t size);
+};
+
+using ByteHistogram = SymbolHistogram<uint8_t>;
+
+
+template <typename Symbol>
+SymbolHistogram<Symbol>::SymbolHistogram()
+{
+    clear();
+}
+
+template <typename Symbol>
+SymbolHistogram<Symbol>::SymbolHistogram(const Symbol* data, size_t size, unsigned threads)
+{
+    clear();
+    add(data, size, threads);
+}
+
+//  Counts the given symbols. Inputs of at least PARALLEL_MIN_SIZE symbols
+//  are split between the given number of threads.
+//      data    -   symbols to count
+//      size    -   number of symbols
+//      threads -   number of threads to count with
+template <typename Symbol>
+void SymbolHistogram<Symbol>::add(const Symbol* data, size_t size, unsigned threads)
+{
+    if (threads <= 1 || size < PARALLEL_MIN_SIZE) {
+        count(data, size);
+        return;
+    }
+
+    std::vector<SymbolHistogram> partial(threads);
+    std::vector<std::thread> workers;
+    size_t chunk = size / threads;
+    for (unsigned t = 0; t < threads; t++) {
+        size_t begin = t * chunk;
+        size_t end = (t + 1 == threads) ? size : begin + chunk;
+        workers.emplace_back([&partial, data, begin, end, t]() {
+            partial[t].count(data + begin, end - begin);
+        });
+    }
+    for (unsigned t = 0; t < threads; t++) {
+        workers[t].join();
+        add(partial[t]);
+    }
+}
+
+//  Adds the counts of another histogram to this one
+template <typename Symbol>
+void SymbolHistogram<Symbol>::add(const SymbolHistogram& other)
+{
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        counts[i] += other.counts[i];
+    }
+    total += other.total;
+}
+
+//  Adds count occurrences of a single symbol
+template <typename Symbol>
+void SymbolHistogram<Symbol>::add(Symbol symbol, uint64_t count)
+{
+    counts[symbol] += count;
+    total += count;
+}
+
+//  Multiplies every count by factor, rounding down
+template <typename Symbol>
+void SymbolHistogram<Symbol>::scale(double factor)
+{
+    total = 0;
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        counts[i] = static_cast<uint64_t>(counts[i] * factor);
+        total += counts[i];
+    }
+}
+
+template <typename Symbol>
+void SymbolHistogram<Symbol>::clear()
+{
+    std::memset(counts.data(), 0, ALPHABET_SIZE * sizeof(uint64_t));
+    total = 0;
+}
+
+template <typename Symbol>
+uint64_t SymbolHistogram<Symbol>::get_count(Symbol symbol) const
+{
+    return counts[symbol];
+}
+
+//  Returns the array of ALPHABET_SIZE counts indexed by symbol
+template <typename Symbol>
+const uint64_t* SymbolHistogram<Symbol>::get_counts() const
+{
+    return counts.data();
+}
+
+//  Returns the number of counted symbols
+template <typename Symbol>
+uint64_t SymbolHistogram<Symbol>::get_total() const
+{
+    return total;
+}
+
+//  Returns the number of distinct symbols counted
+template <typename Symbol>
+size_t SymbolHistogram<Symbol>::get_alphabetSize() const
+{
+    size_t result = 0;
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        if (counts[i] != 0) ++result;
+    }
+    return result;
+}
+
+template <typename Symbol>
+void SymbolHistogram<Symbol>::count(const Symbol* data, size_t size)
+{
+    if constexpr (SymbolTraits<Symbol>::BITS != 8) {
+        for (size_t i = 0; i < size; i++) {
+            ++counts[data[i]];
+        }
+        total += size;
+    } else {
+        countBytes(data, size);
+    }
+}
+
+//  Counts bytes over the lanes
+template <typename Symbol>
+void SymbolHistogram<Symbol>::countBytes(const uint8_t* data, size_t size)
+{
+    // 32-bit lanes keep the working set in L1; they are drained into counts
+    // before any of them could overflow
+    const size_t CHUNK = size_t(1) << 30;
+    uint32_t lanes[LANES][256];
+
+    while (size > 0) {
+        size_t length = size < CHUNK ? size : CHUNK;
+        for (unsigned lane = 0; lane < LANES; lane++) {
+            for (int s = 0; s < 256; s++) lanes[lane][s] = 0;
+        }
+
+        size_t i = 0;
+        for (; i + 8 <= length; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, data + i, 8);
+            ++lanes[0][word & 0xFF];
+            ++lanes[1][(word >> 8) & 0xFF];
+            ++lanes[2][(word >> 16) & 0xFF];
+            ++lanes[3][(word >> 24) & 0xFF];
+            ++lanes[0][(word >> 32) & 0xFF];
+            ++lanes[1][(word >> 40) & 0xFF];
+            ++lanes[2][(word >> 48) & 0xFF];
+            ++lanes[3][word >> 56];
+        }
+        for (; i < length; i++) {
+            ++lanes[0][data[i]];
+        }
+
+        for (int s = 0; s < 256; s++) {
+            for (unsigned lane = 0; lane < LANES; lane++) {
+                counts[s] += lanes[lane][s];
+            }
+        }
+        total += length;
+        data += length;
+        size -= length;
+    }
+}
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <cstdint>
+#include <cstddef>
+
+//  CRC-32 (IEEE 802.3, as in zip and gzip), computed eight bytes at a time
+//  with slicing-by-8 tables
+class CRC32
+{
+    public:
+        CRC32();
+
+        void update(const uint8_t* data, size_t size);
+        uint32_t get_value() const;
+
+        static uint32_t compute(const uint8_t* data, size_t size);
+
+    private:
+        uint32_t state;
+
+        struct Tables
+        {
+            uint32_t table[8][256];
+            Tables();
+        };
+        static const Tables tables;
+};
+
+
+const CRC32::Tables CRC32::tables;
+
+CRC32::Tables::Tables()
+{
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+        table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int slice = 1; slice < 8; slice++) {
+            table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+        }
+    }
+}
+
+CRC32::CRC32()
+{
+    state = 0xFFFFFFFFu;
+}
+
+//  Adds bytes to the checksum
+void CRC32::update(const uint8_t* data, size_t size)
+{
+    uint32_t crc = state;
+    const uint32_t (*t)[256] = tables.table;
+    for (; size >= 8; size -= 8, data += 8) {
+        uint32_t low = crc ^ (uint32_t(data[0]) | uint32_t(data[1]) << 8 |
+                              uint32_t(data[2]) << 16 | uint32_t(data[3]) << 24);
+        crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^
+              t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+              t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+    }
+    for (; size > 0; size--, data++) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xFF];
+    }
+    state = crc;
+}
+
+//  Returns the checksum of all bytes added so far
+uint32_t CRC32::get_value() const
+{
+    return state ^ 0xFFFFFFFFu;
+}
+
+//  Returns the checksum of the given bytes
+uint32_t CRC32::compute(const uint8_t* data, size_t size)
+{
+    CRC32 crc;
+    crc.update(data, size);
+    return crc.get_value();
+}
+
+#endif
@@ -0,0 +1,356 @@
+#ifndef MappedFile_H
+#define MappedFile_H
+
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//  Read-only memory mapping of a whole file.
+//  The pages are loaded by the operating system as they are touched, so a
+//  file can be processed straight from the mapping without copying it into
+//  a buffer. discard() hands pages that are no longer needed back to the
+//  system, which keeps the resident size bounded when a large file is read
+//  once from start to end. An empty file maps to a null pointer.
+class MappedFile
+{
+    public:
+        MappedFile(const std::string& path);
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        void discard(size_t offset, size_t size);
+        const uint8_t* get_data() const;
+        size_t get_size() const;
+
+    private:
+        const uint8_t* data;
+        size_t size;
+        size_t pageSize;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#endif
+};
+
+
+//  Writable memory mapping of a file created with a fixed size, so that
+//  several threads can fill disjoint parts of it in place. The file space
+//  is allocated up front where the system supports it, so running out of
+//  disk space is reported by the constructor rather than by a fault on a
+//  later write. The pages are written back to the file by the system;
+//  discard() lets it do so early for pages that are complete, which keeps
+//  the resident size bounded when a large file is written once from start
+//  to end. close() unmaps the file and reports errors, the destructor
+//  closes silently. An empty file maps to a null pointer.
+class MappedOutputFile
+{
+    public:
+        MappedOutputFile(const std::string& path, size_t size);
+        ~MappedOutputFile();
+
+        MappedOutputFile(const MappedOutputFile&) = delete;
+        MappedOutputFile& operator=(const MappedOutputFile&) = delete;
+
+        void discard(size_t offset, size_t size);
+        void close();
+        uint8_t* get_data() const;
+        size_t get_size() const;
+
+    private:
+        uint8_t* data;
+        size_t size;
+        size_t pageSize;
+        std::string path;
+#ifdef _WIN32
+        HANDLE file;
+        HANDLE mapping;
+#else
+        int file;
+#endif
+};
+
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+{
+    data = nullptr;
+    size = 0;
+    mapping = nullptr;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pageSize = info.dwAllocationGranularity;
+
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize)) {
+        CloseHandle(file);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    size = static_cast<size_t>(fileSize.QuadPart);
+    if (size == 0) {
+        return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping != nullptr) {
+        data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (data == nullptr) {
+        if (mapping != nullptr) CloseHandle(mapping);
+        CloseHandle(file);
+        throw std::runtime_error("Cannot map " + path);
+    }
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping != nullptr) CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+MappedOutputFile::MappedOutputFile(const std::string& path, size_t size) : path(path)
+{
+    data = nullptr;
+    this->size = size;
+    mapping = nullptr;
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    pageSize = info.dwAllocationGranularity;
+
+    file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                       FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw std::runtime_error("Cannot create " + path);
+    }
+    if (size == 0) {
+        return;
+    }
+    //  mapping more than the file holds extends it to the mapped size
+    uint64_t extent = size;
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READWRITE, DWORD(extent >> 32), DWORD(extent), nullptr);
+    if (mapping != nullptr) {
+        data = static_cast<uint8_t*>(MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, 0));
+    }
+    if (data == nullptr) {
+        if (mapping != nullptr) CloseHandle(mapping);
+        CloseHandle(file);
+        file = INVALID_HANDLE_VALUE;
+        throw std::runtime_error("Cannot map " + path);
+    }
+}
+
+//  Unmaps and closes the file. Throws runtime_error if that fails.
+void MappedOutputFile::close()
+{
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    bool failed = data != nullptr && !UnmapViewOfFile(data);
+    if (mapping != nullptr) CloseHandle(mapping);
+    failed = !CloseHandle(file) || failed;
+    data = nullptr;
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+    if (failed) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+MappedOutputFile::~MappedOutputFile()
+{
+    if (file == INVALID_HANDLE_VALUE) {
+        return;
+    }
+    if (data != nullptr) UnmapViewOfFile(data);
+    if (mapping != nullptr) CloseHandle(mapping);
+    CloseHandle(file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path)
+{
+    data = nullptr;
+    size = 0;
+    pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Cannot open " + path);
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        close(file);
+        throw std::runtime_error("Cannot read " + path);
+    }
+    size = static_cast<size_t>(status.st_size);
+    if (size == 0) {
+        close(file);
+        return;
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map " + path);
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(mapped);
+}
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr) munmap(const_cast<uint8_t*>(data), size);
+}
+
+MappedOutputFile::MappedOutputFile(const std::string& path, size_t size) : path(path)
+{
+    data = nullptr;
+    this->size = size;
+    pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+    file = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0666);
+    if (file < 0) {
+        throw std::runtime_error("Cannot create " + path);
+    }
+    if (size == 0) {
+        return;
+    }
+    //  file systems that cannot allocate up front still get a sized file
+    int allocated = posix_fallocate(file, 0, off_t(size));
+    if (allocated == EINVAL || allocated == EOPNOTSUPP) {
+        allocated = ftruncate(file, off_t(size)) == 0 ? 0 : errno;
+    }
+    if (allocated != 0) {
+        ::close(file);
+        file = -1;
+        throw std::runtime_error("Cannot write " + path);
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+    if (mapped == MAP_FAILED) {
+        ::close(file);
+        file = -1;
+        throw std::runtime_error("Cannot map " + path);
+    }
+    data = static_cast<uint8_t*>(mapped);
+}
+
+//  Unmaps and closes the file. Throws runtime_error if that fails.
+void MappedOutputFile::close()
+{
+    if (file < 0) {
+        return;
+    }
+    bool failed = data != nullptr && munmap(data, size) != 0;
+    failed = ::close(file) != 0 || failed;
+    data = nullptr;
+    file = -1;
+    if (failed) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+MappedOutputFile::~MappedOutputFile()
+{
+    if (file < 0) {
+        return;
+    }
+    if (data != nullptr) munmap(data, size);
+    ::close(file);
+}
+
+#endif
+
+//  Tells the system that the whole pages inside the given range will not be
+//  read again. The mapping stays valid; discarded pages are read back from
+//  the file if they are touched later. Pages only partly inside the range
+//  are kept.
+//      offset  -   first byte of the range
+//      size    -   number of bytes in the range
+void MappedFile::discard(size_t offset, size_t size)
+{
+    if (data == nullptr || offset >= this->size) {
+        return;
+    }
+    size_t end = (size < this->size - offset) ? offset + size : this->size;
+    size_t first = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t last = (end == this->size) ? end : end / pageSize * pageSize;
+    if (first >= last) {
+        return;
+    }
+#ifdef _WIN32
+    //  unlocking pages that are not locked removes them from the working set
+    VirtualUnlock(const_cast<uint8_t*>(data + first), last - first);
+#else
+    madvise(const_cast<uint8_t*>(data + first), last - first, MADV_DONTNEED);
+#endif
+}
+
+//  Returns the first byte of the mapping, or nullptr for an empty file
+const uint8_t* MappedFile::get_data() const
+{
+    return data;
+}
+
+//  Returns the size of the file in bytes
+size_t MappedFile::get_size() const
+{
+    return size;
+}
+
+//  Tells the system that the whole pages inside the given range are written
+//  and will not be touched again: they are written back to the file and
+//  leave the resident set. Pages only partly inside the range are kept.
+//      offset  -   first byte of the range
+//      size    -   number of bytes in the range
+void MappedOutputFile::discard(size_t offset, size_t size)
+{
+    if (data == nullptr || offset >= this->size) {
+        return;
+    }
+    size_t end = (size < this->size - offset) ? offset + size : this->size;
+    size_t first = (offset + pageSize - 1) / pageSize * pageSize;
+    size_t last = (end == this->size) ? end : end / pageSize * pageSize;
+    if (first >= last) {
+        return;
+    }
+#ifdef _WIN32
+    FlushViewOfFile(data + first, last - first);
+    VirtualUnlock(data + first, last - first);
+#else
+    //  dirty pages of a shared mapping stay in the page cache when unmapped
+    msync(data + first, last - first, MS_ASYNC);
+    madvise(data + first, last - first, MADV_DONTNEED);
+#endif
+}
+
+//  Returns the first byte of the mapping, or nullptr for an empty file
+uint8_t* MappedOutputFile::get_data() const
+{
+    return data;
+}
+
+//  Returns the size of the file in bytes
+size_t MappedOutputFile::get_size() const
+{
+    return size;
+}
+
+#endif
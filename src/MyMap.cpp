@@ -4,16 +4,22 @@
 #include <stdexcept>
 #include <string>
 #include <iostream>
+#include <iterator>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <LinkedList.cpp>
+#include <NodePool.cpp>
 
 template <typename Key, typename Value> class TreeNode;
-template <typename Key, typename Value> class MyMap;
+template <typename Key, typename Value, typename Allocator = NodePool<TreeNode<Key, Value>>> class MyMap;
 
 
 template <typename Key, typename Value>
 class TreeNode
 {
-    friend class MyMap<Key, Value>;
+    template <typename, typename, typename> friend class MyMap;
 
     private:
         TreeNode(Key key, Value value, bool color = 0,
@@ -49,40 +55,132 @@ class TreeNode
 };
 
 
-template <typename Key, typename Value>
+//  Ordered map on a red-black tree. Nodes come from the Allocator, by default
+//  a NodePool owned by the map (see NodePool.cpp for the interface); the map
+//  cannot be copied, as its nodes belong to its allocator.
+//  Iterators visit the entries in key order, in place; dereferencing one
+//  gives a pair of references to the key and the value, so
+//      for (auto [key, value] : map)
+//  scans the map and lower_bound() / upper_bound() delimit ranges of keys.
+//  An iterator stays valid until its entry is removed.
+//  A map can be built from, or merged with, a sorted range of pairs in
+//  linear time: the nodes are linked into a balanced tree directly instead
+//  of being inserted one by one.
+template <typename Key, typename Value, typename Allocator>
 class MyMap
 {
 
     friend class TreeNode<Key, Value>;
 
+    template <bool Const>
+    class Iterator
+    {
+        friend class MyMap;
+        template <bool> friend class Iterator;
+
+        public:
+            using MappedRef = typename std::conditional<Const, const Value&, Value&>::type;
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = std::pair<const Key, Value>;
+            using difference_type = std::ptrdiff_t;
+            using reference = std::pair<const Key&, MappedRef>;
+
+            struct pointer
+            {
+                reference entry;
+                const reference* operator->() const { return &entry; }
+            };
+
+            Iterator() : map(nullptr), node(nullptr) {}
+            template <bool OtherConst, typename = typename std::enable_if<Const && !OtherConst>::type>
+            Iterator(const Iterator<OtherConst>& other) : map(other.map), node(other.node) {}
+
+            reference operator*() const { return reference(node->key, node->value); }
+            pointer operator->() const { return pointer{**this}; }
+            const Key& key() const { return node->key; }
+            MappedRef value() const { return node->value; }
+
+            Iterator& operator++() { node = map->next(node); return *this; }
+            Iterator& operator--() { node = map->previous(node); return *this; }
+            Iterator operator++(int) { Iterator old = *this; ++*this; return old; }
+            Iterator operator--(int) { Iterator old = *this; --*this; return old; }
+
+            bool operator==(const Iterator& other) const { return node == other.node; }
+            bool operator!=(const Iterator& other) const { return node != other.node; }
+
+        private:
+            const MyMap* map;
+            TreeNode<Key, Value>* node;
+
+            Iterator(const MyMap* map, TreeNode<Key, Value>* node) : map(map), node(node) {}
+    };
+
     public:
 
+        using iterator = Iterator<false>;
+        using const_iterator = Iterator<true>;
+
         MyMap();
         MyMap(std::initializer_list<std::pair<Key, Value>> initList);
+        template <typename PairIterator>
+        MyMap(PairIterator first, PairIterator last);
+        MyMap(const MyMap&) = delete;
+        MyMap& operator=(const MyMap&) = delete;
         ~MyMap();
         
         void insert(Key key, Value value);
+        Value& upsert(Key key, Value value);
+        Value& operator[](Key key);
         void remove(Key key);
         Value find(Key key);
+        Value* lookup(Key key);
+        const Value* lookup(Key key) const;
         bool has(Key key);
         void addToValue(Key key, int add);
+        template <typename PairIterator>
+        void mergeSorted(PairIterator first, PairIterator last);
+        size_t get_size() const;
         void clear();
         LinkedList<Key> get_keys();
         LinkedList<Value> get_values();
         void printKeys();
         void printValues();
 
+        iterator begin();
+        iterator end();
+        const_iterator begin() const;
+        const_iterator end() const;
+        iterator lower_bound(const Key& key);
+        iterator upper_bound(const Key& key);
+        std::pair<iterator, iterator> equal_range(const Key& key);
+        const_iterator lower_bound(const Key& key) const;
+        const_iterator upper_bound(const Key& key) const;
+        std::pair<const_iterator, const_iterator> equal_range(const Key& key) const;
+
 
     private:
 
         TreeNode<Key, Value>* root;
         TreeNode<Key, Value>* nil;
+        Allocator allocator;
+        size_t size;
 
+        TreeNode<Key, Value>* findNode(const Key& key) const;
+        TreeNode<Key, Value>* locate(const Key& key, const Value& value, bool& inserted);
+        TreeNode<Key, Value>* createNode(Key key, Value value, TreeNode<Key, Value>* parent);
+        void destroyNode(TreeNode<Key, Value>* node);
         void destroyRecursive(TreeNode<Key, Value>* node);
+        TreeNode<Key, Value>* buildTree(TreeNode<Key, Value>** nodes, size_t count,
+                                        TreeNode<Key, Value>* parent, unsigned depth, unsigned redDepth);
         void leftRotate(TreeNode<Key, Value>* x);
         void rightRotate(TreeNode<Key, Value>* x);
         void transplant(TreeNode<Key, Value>* child, TreeNode<Key, Value>* deletion);
-        TreeNode<Key, Value>* minimum(TreeNode<Key, Value>* start);
+        TreeNode<Key, Value>* minimum(TreeNode<Key, Value>* start) const;
+        TreeNode<Key, Value>* maximum(TreeNode<Key, Value>* start) const;
+        TreeNode<Key, Value>* next(TreeNode<Key, Value>* node) const;
+        TreeNode<Key, Value>* previous(TreeNode<Key, Value>* node) const;
+        TreeNode<Key, Value>* lowerBound(const Key& key) const;
+        TreeNode<Key, Value>* upperBound(const Key& key) const;
         void get_keysHelper(const TreeNode<Key, Value>* node, LinkedList<Key>& result);
         void get_valuesHelper(const TreeNode<Key, Value>* node, LinkedList<Value>& result);
         void printKeysHelper(const std::string& prefix, const TreeNode<Key, Value>* node, bool isLeft);
@@ -95,75 +193,134 @@ class MyMap
     
 };
 
-template <typename Key, typename Value>
-MyMap<Key, Value>::MyMap()
+template <typename Key, typename Value, typename Allocator>
+MyMap<Key, Value, Allocator>::MyMap()
 {
     nil = new TreeNode<Key, Value>();
     root = nil;
+    size = 0;
 }
 
-template <typename Key, typename Value>
-MyMap<Key, Value>::MyMap(std::initializer_list<std::pair<Key, Value>> initList)
+template <typename Key, typename Value, typename Allocator>
+MyMap<Key, Value, Allocator>::MyMap(std::initializer_list<std::pair<Key, Value>> initList)
 {
     nil = new TreeNode<Key, Value>();
     root = nil;
+    size = 0;
     for (auto pair : initList) {
         insert(pair.first, pair.second);
     }
 }
 
-template <typename Key, typename Value>
-MyMap<Key, Value>::~MyMap()
+//  Builds the map from pairs sorted by strictly increasing key in linear
+//  time, with the nodes in one block of the allocator. Throws
+//  invalid_argument if the keys are not strictly increasing.
+//      first   -   forward iterator to the first (key, value) pair
+//      last    -   iterator past the last pair
+template <typename Key, typename Value, typename Allocator>
+template <typename PairIterator>
+MyMap<Key, Value, Allocator>::MyMap(PairIterator first, PairIterator last)
 {
-    destroyRecursive(this->root);
+    nil = new TreeNode<Key, Value>();
+    root = nil;
+    size = 0;
+    try {
+        mergeSorted(first, last);
+    } catch (...) {
+        delete nil;
+        throw;
+    }
+}
+
+template <typename Key, typename Value, typename Allocator>
+MyMap<Key, Value, Allocator>::~MyMap()
+{
+    clear();
     delete nil;
 }
 
 //  Inserts a node with the given key and value in the tree.
 //  If such node already exists throws invalid_argument exception.
-template <typename Key, typename Value>
-void MyMap<Key, Value>::insert(Key key, Value value)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::insert(Key key, Value value)
 {
-    TreeNode<Key, Value>* insertion = new TreeNode<Key, Value>(key, value, 1, nil, nil, nullptr);
+    bool inserted;
+    locate(key, value, inserted);
+    if (!inserted) {
+        throw std::invalid_argument("No duplicates allowed");
+    }
+}
 
+//  Sets the value of the given key, inserting the key if it is missing, in a
+//  single descent, and returns a reference to the stored value
+template <typename Key, typename Value, typename Allocator>
+Value& MyMap<Key, Value, Allocator>::upsert(Key key, Value value)
+{
+    bool inserted;
+    TreeNode<Key, Value>* node = locate(key, value, inserted);
+    if (!inserted) {
+        node->value = value;
+    }
+    return node->value;
+}
+
+//  Returns a reference to the value of the given key, inserting the key with
+//  a default value if it is missing, so counting is a single descent:
+//  map[key]++
+template <typename Key, typename Value, typename Allocator>
+Value& MyMap<Key, Value, Allocator>::operator[](Key key)
+{
+    bool inserted;
+    return locate(key, Value(), inserted)->value;
+}
+
+//  Returns the node of the given key, or creates it with the given value
+//  where the descent ended and rebalances the tree
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::locate(const Key& key, const Value& value, bool& inserted)
+{
     TreeNode<Key, Value>* leaf = nullptr;
     TreeNode<Key, Value>* current = this->root;
 
      while (current != nil) {
       leaf = current;
-      if (insertion->key < current->key) {
+      if (key < current->key) {
         current = current->left;
-      } else {
+      } else if (current->key < key) {
         current = current->right;
+      } else {
+        inserted = false;
+        return current;
       }
     }
 
-    insertion->parent = leaf;
+    TreeNode<Key, Value>* insertion = createNode(key, value, leaf);
+    inserted = true;
+    size++;
 
     if (leaf == nullptr) {
         root = insertion;
     } else if (insertion->key < leaf->key) {
         leaf->left = insertion;
-    } else if (insertion->key > leaf->key){
-        leaf->right = insertion;
     } else {
-        throw std::invalid_argument("No duplicates allowed");
+        leaf->right = insertion;
     }
 
     if (insertion->parent == nullptr) {
       insertion->color = 0;
-      return;
+      return insertion;
     }
 
     if (insertion->parent->parent == nullptr) {
-      return;
+      return insertion;
     }
 
     insertFix(insertion);
+    return insertion;
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::insertFix(TreeNode<Key, Value>* insertion)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::insertFix(TreeNode<Key, Value>* insertion)
 {
     TreeNode<Key, Value>* other;
     while (insertion->parent->color == 1) {
@@ -208,23 +365,11 @@ void MyMap<Key, Value>::insertFix(TreeNode<Key, Value>* insertion)
 }
 
 //  Removes the node with the given key from the tree
-template <typename Key, typename Value>
-void MyMap<Key, Value>::remove(Key key)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::remove(Key key)
 {
-    TreeNode<Key, Value>* current = this->root, *deletion = nil;
+    TreeNode<Key, Value>* deletion = findNode(key);
     TreeNode<Key, Value>* child;
-    while (current != nil) {
-        if (current->key == key) {
-            deletion = current;
-        }
-        if (current->key <= key) {
-            current = current->right;
-        } else {
-            current = current->left;
-        }
-    }
-
-    
     bool originalColor = deletion->color;
     if (deletion == nil) {
         throw std::invalid_argument("Key not found");
@@ -238,27 +383,28 @@ void MyMap<Key, Value>::remove(Key key)
         TreeNode<Key, Value>* minOfRight= minimum(deletion->right);
         originalColor = minOfRight->color;
         child = minOfRight->right;
-        if (deletion == child->parent) {
-            child->parent = minOfRight;  
+        if (minOfRight->parent == deletion) {
+            child->parent = minOfRight;
         } else {
             transplant(minOfRight, minOfRight->right);
             minOfRight->right = deletion->right;
-            minOfRight->right->parent = child;
+            minOfRight->right->parent = minOfRight;
         }
         transplant(deletion, minOfRight);
         minOfRight->left = deletion->left;
         minOfRight->left->parent = minOfRight;
         minOfRight->color = deletion->color;
     }
-    delete deletion;
+    destroyNode(deletion);
+    size--;
     if (originalColor == 0/*black*/ ) {
         removeFix(child);
     }
 }
 
 // Transplants x with y
-template <typename Key, typename Value>
-void MyMap<Key, Value>::transplant(TreeNode<Key, Value>* x, TreeNode<Key, Value>* y)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::transplant(TreeNode<Key, Value>* x, TreeNode<Key, Value>* y)
 {
     if (x->parent == nullptr) {
         root = y;
@@ -271,8 +417,8 @@ void MyMap<Key, Value>::transplant(TreeNode<Key, Value>* x, TreeNode<Key, Value>
 }
 
 //  Finds the most left node(minimum) from the given position
-template <typename Key, typename Value>
-TreeNode<Key, Value>* MyMap<Key, Value>::minimum(TreeNode<Key, Value>* start)
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::minimum(TreeNode<Key, Value>* start) const
 {
     while (start->left != nil) {
       start = start->left;
@@ -280,8 +426,53 @@ TreeNode<Key, Value>* MyMap<Key, Value>::minimum(TreeNode<Key, Value>* start)
     return start;
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::removeFix(TreeNode<Key, Value>* start)
+//  Finds the most right node(maximum) from the given position
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::maximum(TreeNode<Key, Value>* start) const
+{
+    while (start->right != nil) {
+      start = start->right;
+    }
+    return start;
+}
+
+//  Returns the node following the given one in key order, or nil after the
+//  last node
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::next(TreeNode<Key, Value>* node) const
+{
+    if (node->right != nil) {
+        return minimum(node->right);
+    }
+    TreeNode<Key, Value>* parent = node->parent;
+    while (parent != nullptr && node == parent->right) {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent == nullptr ? nil : parent;
+}
+
+//  Returns the node preceding the given one in key order; nil, the end
+//  position, is preceded by the last node
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::previous(TreeNode<Key, Value>* node) const
+{
+    if (node == nil) {
+        return maximum(root);
+    }
+    if (node->left != nil) {
+        return maximum(node->left);
+    }
+    TreeNode<Key, Value>* parent = node->parent;
+    while (parent != nullptr && node == parent->left) {
+        node = parent;
+        parent = parent->parent;
+    }
+    return parent == nullptr ? nil : parent;
+}
+
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::removeFix(TreeNode<Key, Value>* start)
 {
     TreeNode<Key, Value>* sibling;
     while (start != root && start->color == 0) {
@@ -320,7 +511,7 @@ void MyMap<Key, Value>::removeFix(TreeNode<Key, Value>* start)
           sibling = start->parent->left;
         }
 
-        if (sibling->right->color == 0 && sibling->right->color == 0) {
+        if (sibling->right->color == 0 && sibling->left->color == 0) {
           sibling->color = 1;
           start = start->parent;
         } else {
@@ -344,18 +535,10 @@ void MyMap<Key, Value>::removeFix(TreeNode<Key, Value>* start)
 
 //  Finds the node with the given key and returns its value otherwise throws
 //  exception
-template <typename Key, typename Value>
-Value MyMap<Key, Value>::find(Key key)
+template <typename Key, typename Value, typename Allocator>
+Value MyMap<Key, Value, Allocator>::find(Key key)
 {
-    TreeNode<Key, Value>* current = this->root, *find = nil;
-    while (current != nil) {
-        if (current->key == key) find = current;
-        if (current->key <= key) {
-            current = current->right;
-        } else {
-            current = current->left;
-        }
-    }
+    TreeNode<Key, Value>* find = findNode(key);
     if (find == nil) {
         throw std::invalid_argument("Key not found");
     } else {
@@ -363,55 +546,266 @@ Value MyMap<Key, Value>::find(Key key)
     }
 }
 
-template <typename Key, typename Value>
-bool MyMap<Key, Value>::has(Key key)
+//  Returns a pointer to the value of the given key, or nullptr if the key is
+//  missing; the pointer stays valid until the key is removed
+template <typename Key, typename Value, typename Allocator>
+Value* MyMap<Key, Value, Allocator>::lookup(Key key)
+{
+    TreeNode<Key, Value>* find = findNode(key);
+    return find == nil ? nullptr : &find->value;
+}
+
+template <typename Key, typename Value, typename Allocator>
+const Value* MyMap<Key, Value, Allocator>::lookup(Key key) const
+{
+    TreeNode<Key, Value>* find = findNode(key);
+    return find == nil ? nullptr : &find->value;
+}
+
+template <typename Key, typename Value, typename Allocator>
+bool MyMap<Key, Value, Allocator>::has(Key key)
+{
+    return findNode(key) != nil;
+}
+
+//  Adds add to the value of the given key, if the key is present
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::addToValue(Key key, int add)
+{
+    TreeNode<Key, Value>* find = findNode(key);
+    if (find != nil) {
+        find->value += add;
+    }
+}
+
+//  Returns the node with the given key, or nil, stopping at the first match
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::findNode(const Key& key) const
 {
-    TreeNode<Key, Value>* current = this->root, *find = nil;
+    TreeNode<Key, Value>* current = this->root;
     while (current != nil) {
-        if (current->key == key) find = current;
-        if (current->key <= key) {
+        if (key < current->key) {
+            current = current->left;
+        } else if (current->key < key) {
             current = current->right;
         } else {
-            current = current->left;
+            return current;
         }
     }
-    if (find == nil) {
-        return false;
-    } else {
-        return true;
-    }
+    return nil;
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::addToValue(Key key, int add)
+
+//  Returns the node with the first key not less than the given one, or nil
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::lowerBound(const Key& key) const
 {
-    TreeNode<Key, Value>* current = this->root, *find = nil;
+    TreeNode<Key, Value>* current = this->root, *bound = nil;
     while (current != nil) {
-        if (current->key == key) find = current;
-        if (current->key <= key) {
+        if (current->key < key) {
             current = current->right;
         } else {
+            bound = current;
             current = current->left;
         }
     }
-    if (find == nil) {
-        return;
-    } else {
-        find->value++;
+    return bound;
+}
+
+//  Returns the node with the first key greater than the given one, or nil
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::upperBound(const Key& key) const
+{
+    TreeNode<Key, Value>* current = this->root, *bound = nil;
+    while (current != nil) {
+        if (key < current->key) {
+            bound = current;
+            current = current->left;
+        } else {
+            current = current->right;
+        }
     }
+    return bound;
 }
 
+//  Returns an iterator to the smallest key
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::iterator MyMap<Key, Value, Allocator>::begin()
+{
+    return iterator(this, root == nil ? nil : minimum(root));
+}
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::clear()
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::iterator MyMap<Key, Value, Allocator>::end()
+{
+    return iterator(this, nil);
+}
+
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::const_iterator MyMap<Key, Value, Allocator>::begin() const
+{
+    return const_iterator(this, root == nil ? nil : minimum(root));
+}
+
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::const_iterator MyMap<Key, Value, Allocator>::end() const
+{
+    return const_iterator(this, nil);
+}
+
+//  Returns an iterator to the first key not less than the given one
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::iterator MyMap<Key, Value, Allocator>::lower_bound(const Key& key)
 {
-    destroyRecursive(this->root);
+    return iterator(this, lowerBound(key));
+}
+
+//  Returns an iterator to the first key greater than the given one
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::iterator MyMap<Key, Value, Allocator>::upper_bound(const Key& key)
+{
+    return iterator(this, upperBound(key));
+}
+
+//  Returns the range of entries with the given key, empty or of one entry
+template <typename Key, typename Value, typename Allocator>
+std::pair<typename MyMap<Key, Value, Allocator>::iterator, typename MyMap<Key, Value, Allocator>::iterator>
+MyMap<Key, Value, Allocator>::equal_range(const Key& key)
+{
+    return {lower_bound(key), upper_bound(key)};
+}
+
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::const_iterator
+MyMap<Key, Value, Allocator>::lower_bound(const Key& key) const
+{
+    return const_iterator(this, lowerBound(key));
+}
+
+template <typename Key, typename Value, typename Allocator>
+typename MyMap<Key, Value, Allocator>::const_iterator
+MyMap<Key, Value, Allocator>::upper_bound(const Key& key) const
+{
+    return const_iterator(this, upperBound(key));
+}
+
+template <typename Key, typename Value, typename Allocator>
+std::pair<typename MyMap<Key, Value, Allocator>::const_iterator,
+          typename MyMap<Key, Value, Allocator>::const_iterator>
+MyMap<Key, Value, Allocator>::equal_range(const Key& key) const
+{
+    return {lower_bound(key), upper_bound(key)};
+}
+
+
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::clear()
+{
+    //  nodes that need no destructor go back to the allocator all at once
+    if (!Allocator::BULK_RELEASE || !std::is_trivially_destructible<TreeNode<Key, Value>>::value) {
+        destroyRecursive(this->root);
+    }
+    allocator.release();
     root = nil;
+    size = 0;
+}
+
+//  Returns the number of keys in the map
+template <typename Key, typename Value, typename Allocator>
+size_t MyMap<Key, Value, Allocator>::get_size() const
+{
+    return size;
+}
+
+//  Inserts pairs sorted by strictly increasing key, replacing the values of
+//  keys already in the map. A batch small next to the map is upserted key
+//  by key; a larger one is merged with the entries of the map in a single
+//  pass and the whole tree relinked, reusing its nodes, in O(n + m). Throws
+//  invalid_argument, leaving the map unchanged, if the keys are not
+//  strictly increasing.
+//      first   -   forward iterator to the first (key, value) pair
+//      last    -   iterator past the last pair
+template <typename Key, typename Value, typename Allocator>
+template <typename PairIterator>
+void MyMap<Key, Value, Allocator>::mergeSorted(PairIterator first, PairIterator last)
+{
+    size_t count = 0;
+    for (PairIterator it = first, previous = first; it != last; previous = it, ++it, ++count) {
+        if (count > 0 && !(previous->first < it->first)) {
+            throw std::invalid_argument("Keys are not sorted");
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    //  upserts walk about depth nodes each, with good locality for sorted
+    //  keys; relinking touches every node, so it pays off only for batches
+    //  of about 8 / depth of the map or more
+    unsigned depth = 0;
+    while ((size_t(1) << depth) <= size) depth++;
+    if (count * depth < 8 * size) {
+        for (PairIterator it = first; it != last; ++it) {
+            upsert(it->first, it->second);
+        }
+        return;
+    }
+
+    //  entries of the map and keys of the batch, in order, counting the
+    //  new keys first so their nodes can be reserved in one block
+    std::vector<TreeNode<Key, Value>*> existing;
+    existing.reserve(size);
+    for (TreeNode<Key, Value>* node = root == nil ? nil : minimum(root); node != nil; node = next(node)) {
+        existing.push_back(node);
+    }
+    size_t added = 0, e = 0;
+    for (PairIterator it = first; it != last; ++it) {
+        while (e < existing.size() && existing[e]->key < it->first) e++;
+        if (e == existing.size() || it->first < existing[e]->key) added++;
+    }
+    allocator.reserve(added);
+
+    std::vector<TreeNode<Key, Value>*> merged;
+    merged.reserve(existing.size() + added);
+    e = 0;
+    try {
+        for (PairIterator it = first; it != last; ++it) {
+            while (e < existing.size() && existing[e]->key < it->first) merged.push_back(existing[e++]);
+            if (e < existing.size() && !(it->first < existing[e]->key)) {
+                merged.push_back(existing[e++]);
+            } else {
+                merged.push_back(createNode(it->first, it->second, nullptr));
+            }
+        }
+    } catch (...) {
+        //  the tree is untouched; only the nodes created so far are dropped
+        for (size_t i = 0, j = 0; i < merged.size(); i++) {
+            while (j < existing.size() && existing[j]->key < merged[i]->key) j++;
+            if (j == existing.size() || merged[i] != existing[j]) destroyNode(merged[i]);
+        }
+        throw;
+    }
+    while (e < existing.size()) merged.push_back(existing[e++]);
+
+    //  existing keys get their new values only now, when no allocation can
+    //  fail any more
+    e = 0;
+    for (PairIterator it = first; it != last; ++it) {
+        while (e < existing.size() && existing[e]->key < it->first) e++;
+        if (e < existing.size() && !(it->first < existing[e]->key)) existing[e++]->value = it->second;
+    }
+
+    //  a tree split at the middle has all its leaves on the last two levels;
+    //  colouring the last level red gives every path the same black height
+    unsigned redDepth = 0;
+    while ((size_t(2) << redDepth) <= merged.size()) redDepth++;
+    root = buildTree(merged.data(), merged.size(), nullptr, 0, redDepth);
+    root->color = 0;
+    size = merged.size();
 }
 
 // Returns the list of keys in post-order
-template <typename Key, typename Value>
-LinkedList<Key> MyMap<Key, Value>::get_keys()
+template <typename Key, typename Value, typename Allocator>
+LinkedList<Key> MyMap<Key, Value, Allocator>::get_keys()
 {
     LinkedList<Key> result = {};
     get_keysHelper(this->root, result);
@@ -419,8 +813,8 @@ LinkedList<Key> MyMap<Key, Value>::get_keys()
 }
 
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::get_keysHelper(const TreeNode<Key, Value>* node, LinkedList<Key>& result)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::get_keysHelper(const TreeNode<Key, Value>* node, LinkedList<Key>& result)
 {
     if (node != nil) {
         get_keysHelper(node->left, result);
@@ -430,16 +824,16 @@ void MyMap<Key, Value>::get_keysHelper(const TreeNode<Key, Value>* node, LinkedL
 }
 
 // Returns the list of values in post-order
-template <typename Key, typename Value>
-LinkedList<Value> MyMap<Key, Value>::get_values()
+template <typename Key, typename Value, typename Allocator>
+LinkedList<Value> MyMap<Key, Value, Allocator>::get_values()
 {
     LinkedList<Value> result = {};
     get_valuesHelper(this->root, result);
     return result;
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::get_valuesHelper(const TreeNode<Key, Value>* node, LinkedList<Value>& result)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::get_valuesHelper(const TreeNode<Key, Value>* node, LinkedList<Value>& result)
 {
     if (node != nil) {
         get_valuesHelper(node->left, result);
@@ -448,20 +842,20 @@ void MyMap<Key, Value>::get_valuesHelper(const TreeNode<Key, Value>* node, Linke
     }
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printKeys()
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printKeys()
 {
     printKeysHelper(this->root);
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printKeysHelper(const TreeNode<Key, Value>* node)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printKeysHelper(const TreeNode<Key, Value>* node)
 {
     printKeysHelper("", node, false);    
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printKeysHelper(const std::string& prefix, const TreeNode<Key, Value>* node, bool isLeft)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printKeysHelper(const std::string& prefix, const TreeNode<Key, Value>* node, bool isLeft)
 {
     if (node != nil) {
         std::cout << prefix;
@@ -477,20 +871,20 @@ void MyMap<Key, Value>::printKeysHelper(const std::string& prefix, const TreeNod
     }
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printValues()
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printValues()
 {
     printValuesHelper(this->root);
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printValuesHelper(const TreeNode<Key, Value>* node)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printValuesHelper(const TreeNode<Key, Value>* node)
 {
     printValuesHelper("", node, false);    
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::printValuesHelper(const std::string& prefix, const TreeNode<Key, Value>* node, bool isLeft)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::printValuesHelper(const std::string& prefix, const TreeNode<Key, Value>* node, bool isLeft)
 {
     if (node != nil) {
         std::cout << prefix;
@@ -506,18 +900,57 @@ void MyMap<Key, Value>::printValuesHelper(const std::string& prefix, const TreeN
     }
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::destroyRecursive(TreeNode<Key, Value>* node)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::destroyRecursive(TreeNode<Key, Value>* node)
 {
     if (node != nil) {
         destroyRecursive(node->left);
         destroyRecursive(node->right);
-        delete node;
+        destroyNode(node);
     }
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::leftRotate(TreeNode<Key, Value>* x)
+//  Links count nodes, in key order, into a balanced subtree and returns its
+//  root; nodes at redDepth are coloured red, all others black
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::buildTree(TreeNode<Key, Value>** nodes, size_t count,
+                                                               TreeNode<Key, Value>* parent, unsigned depth,
+                                                               unsigned redDepth)
+{
+    if (count == 0) {
+        return nil;
+    }
+    size_t middle = (count - 1) / 2;
+    TreeNode<Key, Value>* node = nodes[middle];
+    node->parent = parent;
+    node->color = depth == redDepth;
+    node->left = buildTree(nodes, middle, node, depth + 1, redDepth);
+    node->right = buildTree(nodes + middle + 1, count - middle - 1, node, depth + 1, redDepth);
+    return node;
+}
+
+//  Constructs a red node without children in storage from the allocator
+template <typename Key, typename Value, typename Allocator>
+TreeNode<Key, Value>* MyMap<Key, Value, Allocator>::createNode(Key key, Value value, TreeNode<Key, Value>* parent)
+{
+    TreeNode<Key, Value>* node = allocator.allocate();
+    try {
+        return new (node) TreeNode<Key, Value>(key, value, 1, nil, nil, parent);
+    } catch (...) {
+        allocator.deallocate(node);
+        throw;
+    }
+}
+
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::destroyNode(TreeNode<Key, Value>* node)
+{
+    node->~TreeNode();
+    allocator.deallocate(node);
+}
+
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::leftRotate(TreeNode<Key, Value>* x)
 {
     TreeNode<Key, Value>* y = x->right;
     x->right = y->left;
@@ -536,8 +969,8 @@ void MyMap<Key, Value>::leftRotate(TreeNode<Key, Value>* x)
     x->parent = y;
 }
 
-template <typename Key, typename Value>
-void MyMap<Key, Value>::rightRotate(TreeNode<Key, Value>* x)
+template <typename Key, typename Value, typename Allocator>
+void MyMap<Key, Value, Allocator>::rightRotate(TreeNode<Key, Value>* x)
 {
     TreeNode<Key, Value>* y = x->left;
     x->left = y->right;
@@ -0,0 +1,158 @@
+#ifndef NodePool_H
+#define NodePool_H
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <vector>
+
+//  Node allocators for the linked containers. An allocator hands out raw
+//  storage for one node at a time; the container constructs and destroys
+//  the node in it.
+//      T* allocate()               -   storage for one node
+//      void deallocate(T* node)    -   returns the storage of one node
+//      void release()              -   returns the storage of all nodes at
+//                                      once, valid only when none is in use
+//      void reserve(size_t count)  -   hint that count nodes are about to be
+//                                      allocated together
+//      BULK_RELEASE                -   whether release() alone frees the
+//                                      nodes, so a container whose nodes need
+//                                      no destructor can skip visiting them
+
+//  Slab allocator: nodes are carved out of slabs that double in size from
+//  FIRST_SLAB up to MAX_SLAB nodes, so neighbouring nodes share cache lines
+//  and a large container costs a few dozen allocations instead of one per
+//  node. Deallocated nodes go to a free list and are reused first; release()
+//  makes every slab free again but keeps it, so a container cleared and
+//  refilled to the same size allocates nothing. reserve() makes the next
+//  nodes taken from slabs consecutive. The slabs are freed when the pool is
+//  destroyed.
+template <typename T>
+class NodePool
+{
+    public:
+        static constexpr size_t FIRST_SLAB = 64;
+        static constexpr size_t MAX_SLAB = 65536;
+        static constexpr bool BULK_RELEASE = true;
+
+        NodePool();
+        NodePool(const NodePool&) = delete;
+        NodePool& operator=(const NodePool&) = delete;
+
+        T* allocate();
+        void deallocate(T* node);
+        void release();
+        void reserve(size_t count);
+        size_t get_capacity() const;
+
+    private:
+        union Slot
+        {
+            Slot* next;
+            alignas(T) unsigned char storage[sizeof(T)];
+        };
+
+        struct Slab
+        {
+            std::unique_ptr<Slot[]> slots;
+            size_t size;
+        };
+
+        std::vector<Slab> slabs;
+        Slot* freeList;
+        size_t slab;        // slab the unused slots are taken from
+        size_t used;        // slots of that slab handed out so far
+};
+
+//  Allocates every node separately with operator new
+template <typename T>
+class HeapNodeAllocator
+{
+    public:
+        static constexpr bool BULK_RELEASE = false;
+
+        T* allocate() { return static_cast<T*>(::operator new(sizeof(T))); }
+        void deallocate(T* node) { ::operator delete(node); }
+        void release() {}
+        void reserve(size_t) {}
+};
+
+
+template <typename T>
+NodePool<T>::NodePool()
+{
+    freeList = nullptr;
+    slab = 0;
+    used = 0;
+}
+
+//  Returns storage for one node, from the free list if it has any
+template <typename T>
+T* NodePool<T>::allocate()
+{
+    Slot* slot = freeList;
+    if (slot != nullptr) {
+        freeList = slot->next;
+        return reinterpret_cast<T*>(slot->storage);
+    }
+    while (slab < slabs.size() && used == slabs[slab].size) {
+        slab++;
+        used = 0;
+    }
+    if (slab == slabs.size()) {
+        size_t size = slabs.empty() ? FIRST_SLAB : slabs.back().size * 2;
+        if (size > MAX_SLAB) size = MAX_SLAB;
+        slabs.push_back(Slab{std::unique_ptr<Slot[]>(new Slot[size]), size});
+    }
+    slot = &slabs[slab].slots[used++];
+    return reinterpret_cast<T*>(slot->storage);
+}
+
+//  Puts the storage of a destroyed node on the free list
+template <typename T>
+void NodePool<T>::deallocate(T* node)
+{
+    Slot* slot = reinterpret_cast<Slot*>(node);
+    slot->next = freeList;
+    freeList = slot;
+}
+
+//  Takes back every node at once, keeping the slabs for the next ones
+template <typename T>
+void NodePool<T>::release()
+{
+    freeList = nullptr;
+    slab = 0;
+    used = 0;
+}
+
+//  Makes the next count nodes taken from slabs, rather than from the free
+//  list, consecutive: skips to the first slab with that many unused slots,
+//  or adds a slab of at least count slots
+template <typename T>
+void NodePool<T>::reserve(size_t count)
+{
+    while (slab < slabs.size() && slabs[slab].size - used < count) {
+        slab++;
+        used = 0;
+    }
+    if (slab == slabs.size()) {
+        size_t size = slabs.empty() ? FIRST_SLAB : slabs.back().size * 2;
+        if (size > MAX_SLAB) size = MAX_SLAB;
+        if (size < count) size = count;
+        slabs.push_back(Slab{std::unique_ptr<Slot[]>(new Slot[size]), size});
+    }
+}
+
+//  Returns the number of nodes the slabs hold
+template <typename T>
+size_t NodePool<T>::get_capacity() const
+{
+    size_t capacity = 0;
+    for (const Slab& s : slabs) {
+        capacity += s.size;
+    }
+    return capacity;
+}
+
+#endif
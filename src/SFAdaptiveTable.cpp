@@ -0,0 +1,106 @@
+#ifndef SFAdaptiveTable_H
+#define SFAdaptiveTable_H
+
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <SFBlock.cpp>
+#include <SFCodeTable.cpp>
+#include <SFTableBuilder.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+
+//  Chooses the code table of every block of an adaptive stream.
+//  The selector keeps a histogram of the blocks seen so far in which every
+//  older block weighs options.decay times less than the next one. For each
+//  block it compares the exact size of the block encoded with the current
+//  table against the size with a table built from that histogram, or from
+//  the block alone, plus the size of the serialized table. A new table is
+//  only sent when it saves more than it costs, so a stream whose statistics
+//  stay put carries few tables, while a change of distribution is picked up
+//  on the next block.
+class SFAdaptiveTable
+{
+    public:
+        SFAdaptiveTable(const SFOptions& options = SFOptions());
+
+        bool update(const ByteHistogram& block);
+        void reset();
+        const SFCodeTable& get_table() const;
+
+    private:
+        double decay;
+        bool canonical;
+        bool hasTable;
+        ByteHistogram history;
+        SFTableBuilder builder;
+        SFCodeTable table;
+        SFCodeTable candidate;
+        BitWriter writer;
+
+        uint64_t buildCandidate(const ByteHistogram& counts, const ByteHistogram& block);
+};
+
+
+SFAdaptiveTable::SFAdaptiveTable(const SFOptions& options) : builder(options.maxCodeLength)
+{
+    if (!(options.decay >= 0 && options.decay < 1)) {
+        throw std::invalid_argument("Invalid decay");
+    }
+    decay = options.decay;
+    canonical = options.canonical;
+    hasTable = false;
+}
+
+//  Adds the histogram of the next block and returns true if the block has
+//  to carry a new table, which get_table() then returns; otherwise the block
+//  is encoded with the current table.
+bool SFAdaptiveTable::update(const ByteHistogram& block)
+{
+    history.scale(decay);
+    history.add(block);
+
+    //  the table of the history is tried first, as the next blocks are more
+    //  likely to reuse it; the one of the block alone has to beat it
+    uint64_t bestBits = hasTable ? table.cost(block) : UINT64_MAX;
+    bool replaced = false;
+    const ByteHistogram* sources[2] = {&history, &block};
+    for (const ByteHistogram* source : sources) {
+        uint64_t bits = buildCandidate(*source, block);
+        if (bits < bestBits) {
+            std::swap(table, candidate);
+            bestBits = bits;
+            replaced = true;
+        }
+    }
+    hasTable = true;
+    return replaced;
+}
+
+//  Builds candidate from the given counts and returns the size of the block
+//  encoded with it plus the size of the serialized table
+uint64_t SFAdaptiveTable::buildCandidate(const ByteHistogram& counts, const ByteHistogram& block)
+{
+    builder.build(counts, candidate);
+    if (canonical) {
+        candidate.canonicalize();
+    }
+    writer.clear();
+    candidate.write(writer);
+    return candidate.cost(block) + writer.get_bitlength();
+}
+
+//  Forgets all blocks, for the start of a new stream
+void SFAdaptiveTable::reset()
+{
+    history.clear();
+    hasTable = false;
+}
+
+//  Returns the table the last block is encoded with
+const SFCodeTable& SFAdaptiveTable::get_table() const
+{
+    return table;
+}
+
+#endif
@@ -0,0 +1,603 @@
+#ifndef SFBlock_H
+#define SFBlock_H
+
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <CRC32.cpp>
+#include <SFCodeTable.cpp>
+#include <SFContextModel.cpp>
+#include <SFDecoder.cpp>
+#include <SFTableBuilder.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+//  Settings shared by the block based encoders
+struct SFOptions
+{
+    size_t blockSize = size_t(1) << 20;    // uncompressed bytes per block
+    unsigned threads = 1;                   // blocks encoded concurrently
+    bool canonical = false;                 // store code tables as lengths only
+    unsigned maxCodeLength = 24;            // longest code, from 8 to 64 bits
+    bool adaptive = false;                  // reuse code tables across blocks
+    double decay = 0.5;                     // weight of older blocks when adaptive
+    bool contextModel = false;              // code tables per preceding byte
+    unsigned streams = 1;                   // interleaved payload streams per block
+};
+
+//  Appends value to output as a little-endian integer of the given width
+void putLE(std::vector<uint8_t>& output, uint64_t value, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; i++) {
+        output.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+//  Reads a little-endian integer of the given width
+uint64_t getLE(const uint8_t* data, unsigned bytes)
+{
+    uint64_t value = 0;
+    for (unsigned i = 0; i < bytes; i++) {
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+//  Position of one block in an encoded stream
+struct SFBlockInfo
+{
+    uint64_t offset;        // byte offset of the block from the stream start
+    uint64_t bitLength;     // payload length in bits
+    uint64_t rawSize;       // uncompressed size in bytes
+};
+
+//  Encodes and decodes independent blocks, each with its own code table.
+//  Stream layout:
+//      header | block* | u32 0 | u64 blockCount | index entry* |
+//      u64 originalSize | u64 indexOffset
+//  Header layout:
+//      "SFC\x1A" | u8 version | u8 flags | u32 blockSize
+//  Block layout:
+//      u32 rawSize | u32 crc32 | code table | u64 bitLength | payload
+//  Index entry layout, one per block:
+//      u64 offset | u64 bitLength | u32 rawSize
+//  No block is larger than the block size of the header, the last one may be
+//  smaller. The checksum is the CRC-32 of the uncompressed block. The zero rawSize
+//  marks the end of the blocks; indexOffset is the offset of the blockCount
+//  field, so the index can be found from the end of a stream. All integers
+//  are little-endian.
+//  In adaptive streams, marked by FLAG_ADAPTIVE in the header, a u8 table
+//  mode follows the checksum: 1 if a code table follows, 0 if the block
+//  reuses the table of the closest earlier block that has one. Decoding such
+//  a stream needs the header passed to set_header() first.
+//  In context streams, marked by FLAG_CONTEXT, the code table of a block is
+//  replaced by the tables of an SFContextModel, which codes every byte with
+//  the table of the byte before it. Context tables are always canonical and
+//  cannot be combined with adaptive tables.
+//  In interleaved streams, marked by FLAG_INTERLEAVED, the payload of a block
+//  is split into several streams, byte i of the block coded into stream
+//  i % streams, so the decoder can follow them all at once:
+//      u8 streams | u32 size of every stream but the last | stream*
+//  The bit length then counts the whole payload, streams padded to bytes.
+//  Interleaving works with own or adaptive tables, not with context tables.
+//  The coder keeps its buffers and the decoding tables of the last table
+//  read between calls, so reusing one instance for many blocks does not
+//  reallocate them.
+class SFBlockCoder
+{
+    public:
+        static constexpr size_t MAX_BLOCK_SIZE = 0xFFFFFFFFu;
+        static constexpr size_t INDEX_ENTRY_SIZE = 20;
+        static constexpr size_t HEADER_SIZE = 10;
+        static constexpr uint8_t VERSION = 2;
+        static constexpr uint8_t FLAG_ADAPTIVE = 1;
+        static constexpr uint8_t FLAG_CONTEXT = 2;
+        static constexpr uint8_t FLAG_INTERLEAVED = 4;
+        static constexpr uint8_t KNOWN_FLAGS = FLAG_ADAPTIVE | FLAG_CONTEXT | FLAG_INTERLEAVED;
+
+        SFBlockCoder(const SFOptions& options = SFOptions());
+
+        uint64_t encode(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+        uint64_t encode(const uint8_t* data, size_t size, const SFCodeTable& table, bool writeTable,
+                        std::vector<uint8_t>& output);
+        void set_header(uint8_t flags, size_t blockSize);
+        size_t decode(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+        size_t decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity);
+        void loadTable(const uint8_t* data, size_t size);
+        static uint8_t get_flags(const SFOptions& options);
+        static void writeHeader(std::vector<uint8_t>& output, const SFOptions& options);
+        static uint8_t readHeader(const uint8_t* data, size_t size, size_t& blockSize);
+        static void writeEnd(std::vector<uint8_t>& output, const std::vector<SFBlockInfo>& index,
+                             uint64_t offset);
+        static size_t readEnd(const uint8_t* data, size_t size);
+        static uint64_t readIndex(const uint8_t* data, size_t size, std::vector<SFBlockInfo>& index);
+
+    private:
+        SFOptions options;
+        ByteHistogram histogram;
+        SFTableBuilder builder;
+        SFCodeTable table;
+        SFDecoder decoder;
+        SFContextModel model;
+        BitWriter writer;
+        std::vector<BitWriter> streamWriters;
+        uint8_t flags;
+        size_t blockSize;
+        bool hasTable;
+
+        uint64_t writeBlock(const uint8_t* data, size_t size, const SFCodeTable& table, int tableMode,
+                            std::vector<uint8_t>& output);
+        uint64_t writeContextBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+        uint64_t writeStreams(const uint8_t* data, size_t size, const SFCodeTable& table,
+                              std::vector<uint8_t>& output);
+        size_t readTable(const uint8_t* data, size_t size);
+        size_t readBlock(const uint8_t* data, size_t size, size_t rawSize, uint64_t& bitLength);
+        size_t decodePayload(const uint8_t* data, size_t position, uint64_t bitLength, uint8_t* output,
+                             size_t rawSize);
+        bool hasEmptyCode() const;
+        void decodeStreams(const uint8_t* data, size_t size, uint8_t* output, size_t count);
+};
+
+
+SFBlockCoder::SFBlockCoder(const SFOptions& options)
+    : options(options), builder(options.maxCodeLength), model(options.maxCodeLength)
+{
+    flags = 0;
+    blockSize = MAX_BLOCK_SIZE;
+    hasTable = false;
+    if (options.streams > 1) {
+        streamWriters.resize(options.streams);
+    }
+}
+
+//  Appends one encoded block with its own code table to output and returns
+//  its payload length in bits, or with context tables if
+//  options.contextModel is set. Used for streams without FLAG_ADAPTIVE.
+//      data    -   uncompressed bytes, at least one and at most MAX_BLOCK_SIZE
+//      size    -   number of bytes
+//      output  -   destination buffer
+uint64_t SFBlockCoder::encode(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    if (size == 0 || size > MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+    if (options.contextModel) {
+        return writeContextBlock(data, size, output);
+    }
+    histogram.clear();
+    histogram.add(data, size);
+    builder.build(histogram, table);
+    if (options.canonical) {
+        table.canonicalize();
+    }
+    return writeBlock(data, size, table, -1, output);
+}
+
+//  Appends one block of an adaptive stream, encoded with the given table,
+//  to output and returns its payload length in bits.
+//      data        -   uncompressed bytes, at least one and at most
+//                      MAX_BLOCK_SIZE, all present in table
+//      size        -   number of bytes
+//      table       -   code table to encode with
+//      writeTable  -   whether the table is stored in the block or is the
+//                      one of an earlier block
+//      output      -   destination buffer
+uint64_t SFBlockCoder::encode(const uint8_t* data, size_t size, const SFCodeTable& table, bool writeTable,
+                              std::vector<uint8_t>& output)
+{
+    if (size == 0 || size > MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+    return writeBlock(data, size, table, writeTable ? 1 : 0, output);
+}
+
+//  Writes a block; tableMode is -1 for blocks without a table mode byte
+uint64_t SFBlockCoder::writeBlock(const uint8_t* data, size_t size, const SFCodeTable& table, int tableMode,
+                                  std::vector<uint8_t>& output)
+{
+    putLE(output, size, 4);
+    putLE(output, CRC32::compute(data, size), 4);
+    if (tableMode >= 0) {
+        output.push_back(static_cast<uint8_t>(tableMode));
+    }
+    if (tableMode != 0) {
+        writer.clear();
+        table.write(writer);
+        writer.finish();
+        output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+    }
+    if (!streamWriters.empty()) {
+        return writeStreams(data, size, table, output);
+    }
+
+    writer.clear();
+    table.encode(data, size, writer);
+    writer.finish();
+    putLE(output, writer.get_bitlength(), 8);
+    output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+    return writer.get_bitlength();
+}
+
+//  Writes the bit length and the payload of a block split into interleaved
+//  streams. Throws length_error if a stream does not fit its u32 size.
+uint64_t SFBlockCoder::writeStreams(const uint8_t* data, size_t size, const SFCodeTable& table,
+                                    std::vector<uint8_t>& output)
+{
+    for (BitWriter& stream : streamWriters) {
+        stream.clear();
+    }
+    table.encode(data, size, streamWriters.data(), streamWriters.size());
+    uint64_t payloadSize = 1 + 4 * (streamWriters.size() - 1);
+    for (BitWriter& stream : streamWriters) {
+        stream.finish();
+        if (stream.get_bytes().size() > 0xFFFFFFFFu) {
+            throw std::length_error("Interleaved stream is too long");
+        }
+        payloadSize += stream.get_bytes().size();
+    }
+
+    putLE(output, payloadSize * 8, 8);
+    output.push_back(static_cast<uint8_t>(streamWriters.size()));
+    for (size_t s = 0; s + 1 < streamWriters.size(); s++) {
+        putLE(output, streamWriters[s].get_bytes().size(), 4);
+    }
+    for (const BitWriter& stream : streamWriters) {
+        output.insert(output.end(), stream.get_bytes().begin(), stream.get_bytes().end());
+    }
+    return payloadSize * 8;
+}
+
+//  Writes a block of a context stream
+uint64_t SFBlockCoder::writeContextBlock(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    putLE(output, size, 4);
+    putLE(output, CRC32::compute(data, size), 4);
+    model.build(data, size);
+    writer.clear();
+    model.write(writer);
+    writer.finish();
+    output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+
+    writer.clear();
+    model.encode(data, size, writer);
+    writer.finish();
+    putLE(output, writer.get_bitlength(), 8);
+    output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+    return writer.get_bitlength();
+}
+
+//  Sets the header flags and block size of the stream about to be decoded
+//  and forgets the last table read
+void SFBlockCoder::set_header(uint8_t flags, size_t blockSize)
+{
+    this->flags = flags;
+    this->blockSize = blockSize;
+    hasTable = false;
+}
+
+//  Decodes the block at the start of data, appending the uncompressed bytes
+//  to output, and returns the number of bytes the block occupies. Returns 0
+//  at the end marker. Throws runtime_error on truncated or corrupted input,
+//  leaving output as it was; the block is checked against its payload size
+//  before output grows.
+//      data    -   encoded blocks
+//      size    -   number of bytes available
+//      output  -   destination buffer
+size_t SFBlockCoder::decode(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    if (size < 4) {
+        throw std::runtime_error("Truncated block");
+    }
+    size_t rawSize = getLE(data, 4);
+    if (rawSize == 0) {
+        return 0;
+    }
+    uint64_t bitLength;
+    size_t position = readBlock(data, size, rawSize, bitLength);
+    size_t offset = output.size();
+    output.resize(offset + rawSize);
+    try {
+        return decodePayload(data, position, bitLength, output.data() + offset, rawSize);
+    } catch (...) {
+        output.resize(offset);
+        throw;
+    }
+}
+
+//  Decodes the block at the start of data into output and returns the number
+//  of bytes the block occupies, or 0 at the end marker. Throws runtime_error
+//  on truncated or corrupted input or if the block does not fit in capacity
+//  bytes.
+//      data        -   encoded blocks
+//      size        -   number of bytes available
+//      output      -   destination of the uncompressed bytes
+//      capacity    -   size of output
+size_t SFBlockCoder::decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity)
+{
+    if (size < 4) {
+        throw std::runtime_error("Truncated block");
+    }
+    size_t rawSize = getLE(data, 4);
+    if (rawSize == 0) {
+        return 0;
+    }
+    if (rawSize > capacity) {
+        throw std::runtime_error("Block does not fit in output");
+    }
+    uint64_t bitLength;
+    size_t position = readBlock(data, size, rawSize, bitLength);
+    return decodePayload(data, position, bitLength, output, rawSize);
+}
+
+//  Reads the code table and bit length of the block of rawSize bytes at the
+//  start of data and returns the offset of its payload. Throws runtime_error
+//  if the block is truncated, larger than the block size of the stream or
+//  its payload is too short for rawSize bytes: every code is at least one
+//  bit long, unless a table has a single symbol.
+size_t SFBlockCoder::readBlock(const uint8_t* data, size_t size, size_t rawSize, uint64_t& bitLength)
+{
+    if (rawSize > blockSize) {
+        throw std::runtime_error("Invalid block size");
+    }
+    if (size < 8) {
+        throw std::runtime_error("Truncated block");
+    }
+    size_t position = readTable(data, size);
+    if (size - position < 8) {
+        throw std::runtime_error("Truncated block");
+    }
+    bitLength = getLE(data + position, 8);
+    position += 8;
+    if (bitLength > 8 * uint64_t(size - position)) {
+        throw std::runtime_error("Truncated block");
+    }
+    if (rawSize > bitLength && !hasEmptyCode()) {
+        throw std::runtime_error("Invalid block size");
+    }
+    return position;
+}
+
+//  Decodes the payload at the given position of the block at the start of
+//  data and checks it against the checksum of the block. Returns the number
+//  of bytes the block occupies.
+size_t SFBlockCoder::decodePayload(const uint8_t* data, size_t position, uint64_t bitLength, uint8_t* output,
+                                   size_t rawSize)
+{
+    uint32_t checksum = getLE(data + 4, 4);
+    uint64_t payloadSize = (bitLength + 7) / 8;
+    if (flags & FLAG_CONTEXT) {
+        model.decode(data + position, payloadSize, output, rawSize);
+    } else if (flags & FLAG_INTERLEAVED) {
+        decodeStreams(data + position, payloadSize, output, rawSize);
+    } else {
+        decoder.decode(data + position, payloadSize, output, rawSize);
+    }
+    if (CRC32::compute(output, rawSize) != checksum) {
+        throw std::runtime_error("Block checksum mismatch");
+    }
+    return position + payloadSize;
+}
+
+//  Returns whether the last table read has a code of no bits, which only a
+//  table of a single symbol has
+bool SFBlockCoder::hasEmptyCode() const
+{
+    if (flags & FLAG_CONTEXT) {
+        for (unsigned c = 0; c < SFContextModel::CONTEXTS; c++) {
+            if (model.get_table(c).get_alphabetSize() == 1) {
+                return true;
+            }
+        }
+        return false;
+    }
+    return table.get_alphabetSize() == 1;
+}
+
+//  Decodes the payload of an interleaved block after checking its stream
+//  sizes against the payload size
+void SFBlockCoder::decodeStreams(const uint8_t* data, size_t size, uint8_t* output, size_t count)
+{
+    unsigned streams = size > 0 ? data[0] : 0;
+    if (streams == 0 || streams > SFDecoder::MAX_STREAMS || size < 1 + 4 * (streams - 1)) {
+        throw std::runtime_error("Invalid interleaved payload");
+    }
+    size_t offsets[SFDecoder::MAX_STREAMS + 1];
+    offsets[0] = 1 + 4 * (streams - 1);
+    for (unsigned s = 1; s < streams; s++) {
+        uint64_t streamSize = getLE(data + 1 + 4 * (s - 1), 4);
+        if (streamSize > size - offsets[s - 1]) {
+            throw std::runtime_error("Invalid interleaved payload");
+        }
+        offsets[s] = offsets[s - 1] + streamSize;
+    }
+    offsets[streams] = size;
+    decoder.decode(data, offsets, streams, output, count);
+}
+
+//  Reads the code table of the adaptive block at the start of data, so that
+//  blocks reusing it can be decoded next. Throws runtime_error if the block
+//  is truncated or has no table.
+//      data    -   encoded block with a code table
+//      size    -   number of bytes available
+void SFBlockCoder::loadTable(const uint8_t* data, size_t size)
+{
+    if (size < 9 || (flags & FLAG_ADAPTIVE) == 0 || data[8] != 1) {
+        throw std::runtime_error("Block has no code table");
+    }
+    readTable(data, size);
+}
+
+//  Reads the table mode and code table of the block at the start of data,
+//  whose size and checksum are already checked, and returns the offset of
+//  the bit length field
+size_t SFBlockCoder::readTable(const uint8_t* data, size_t size)
+{
+    size_t position = 8;
+    if (flags & FLAG_ADAPTIVE) {
+        if (size < 9) {
+            throw std::runtime_error("Truncated block");
+        }
+        uint8_t tableMode = data[position++];
+        if (tableMode > 1) {
+            throw std::runtime_error("Invalid table mode");
+        }
+        if (tableMode == 0) {
+            if (!hasTable) {
+                throw std::runtime_error("Missing code table");
+            }
+            return position;
+        }
+    }
+    hasTable = false;
+    if (flags & FLAG_CONTEXT) {
+        position += model.read(data + position, size - position);
+    } else {
+        position += table.read(data + position, size - position);
+        decoder.reset(table);
+    }
+    hasTable = true;
+    return position;
+}
+
+//  Returns the header flags of a stream encoded with the given options.
+//  Throws invalid_argument if the options cannot be combined.
+uint8_t SFBlockCoder::get_flags(const SFOptions& options)
+{
+    if (options.adaptive && options.contextModel) {
+        throw std::invalid_argument("Adaptive tables cannot be combined with context tables");
+    }
+    if (options.streams == 0 || options.streams > SFDecoder::MAX_STREAMS) {
+        throw std::invalid_argument("Invalid number of interleaved streams");
+    }
+    if (options.streams > 1 && options.contextModel) {
+        throw std::invalid_argument("Interleaved streams cannot be combined with context tables");
+    }
+    return (options.adaptive ? FLAG_ADAPTIVE : 0) | (options.contextModel ? FLAG_CONTEXT : 0) |
+           (options.streams > 1 ? FLAG_INTERLEAVED : 0);
+}
+
+//  Appends the stream header.
+//      output  -   destination buffer
+//      options -   options of the stream, whose flags and block size the
+//                  decoder has to know about
+void SFBlockCoder::writeHeader(std::vector<uint8_t>& output, const SFOptions& options)
+{
+    const uint8_t magic[4] = {'S', 'F', 'C', 0x1A};
+    output.insert(output.end(), magic, magic + 4);
+    output.push_back(VERSION);
+    output.push_back(get_flags(options));
+    putLE(output, options.blockSize, 4);
+}
+
+//  Checks the stream header at the start of data and returns its flags.
+//  Throws runtime_error if data does not start with a supported header.
+//      data        -   encoded stream
+//      size        -   number of bytes available
+//      blockSize   -   receives the largest uncompressed size of a block
+uint8_t SFBlockCoder::readHeader(const uint8_t* data, size_t size, size_t& blockSize)
+{
+    if (size < HEADER_SIZE || data[0] != 'S' || data[1] != 'F' || data[2] != 'C' || data[3] != 0x1A) {
+        throw std::runtime_error("Not an SFCoder stream");
+    }
+    if (data[4] != VERSION) {
+        throw std::runtime_error("Unsupported stream version");
+    }
+    if ((data[5] & ~KNOWN_FLAGS) ||
+        ((data[5] & FLAG_CONTEXT) && (data[5] & (FLAG_ADAPTIVE | FLAG_INTERLEAVED)))) {
+        throw std::runtime_error("Unsupported stream flags");
+    }
+    blockSize = getLE(data + 6, 4);
+    if (blockSize == 0) {
+        throw std::runtime_error("Invalid block size");
+    }
+    return data[5];
+}
+
+//  Appends the end marker and the block index.
+//      output  -   destination buffer
+//      index   -   blocks of the stream, in order
+//      offset  -   stream offset at which the end marker is written
+void SFBlockCoder::writeEnd(std::vector<uint8_t>& output, const std::vector<SFBlockInfo>& index,
+                            uint64_t offset)
+{
+    putLE(output, 0, 4);
+    putLE(output, index.size(), 8);
+    for (const SFBlockInfo& block : index) {
+        putLE(output, block.offset, 8);
+        putLE(output, block.bitLength, 8);
+        putLE(output, block.rawSize, 4);
+    }
+    uint64_t originalSize = 0;
+    for (const SFBlockInfo& block : index) {
+        originalSize += block.rawSize;
+    }
+    putLE(output, originalSize, 8);
+    putLE(output, offset + 4, 8);
+}
+
+//  Returns the number of bytes taken by the end marker and block index at
+//  the start of data. Throws runtime_error if they are truncated.
+size_t SFBlockCoder::readEnd(const uint8_t* data, size_t size)
+{
+    if (size < 12 || getLE(data, 4) != 0) {
+        throw std::runtime_error("Truncated block index");
+    }
+    uint64_t count = getLE(data + 4, 8);
+    if (count > (size - 12) / INDEX_ENTRY_SIZE || size - 12 - count * INDEX_ENTRY_SIZE < 16) {
+        throw std::runtime_error("Truncated block index");
+    }
+    return 12 + count * INDEX_ENTRY_SIZE + 16;
+}
+
+//  Reads the block index of a whole encoded stream and returns the original
+//  size. Throws runtime_error if the index is missing or inconsistent.
+//      data    -   encoded stream
+//      size    -   size of the stream in bytes
+//      index   -   receives the blocks of the stream
+uint64_t SFBlockCoder::readIndex(const uint8_t* data, size_t size, std::vector<SFBlockInfo>& index)
+{
+    size_t blockSize;
+    uint8_t flags = readHeader(data, size, blockSize);
+    if (size < HEADER_SIZE + 28) {
+        throw std::runtime_error("Missing block index");
+    }
+    uint64_t indexOffset = getLE(data + size - 8, 8);
+    if (indexOffset < HEADER_SIZE + 4 || indexOffset > size - 24) {
+        throw std::runtime_error("Invalid block index");
+    }
+    uint64_t count = getLE(data + indexOffset, 8);
+    if (count != (size - 24 - indexOffset) / INDEX_ENTRY_SIZE ||
+        (size - 24 - indexOffset) % INDEX_ENTRY_SIZE != 0) {
+        throw std::runtime_error("Invalid block index");
+    }
+
+    //  No block exceeds the block size of the header. Blocks also hold at
+    //  most 8 bytes per compressed byte, as every code is at least one bit
+    //  long, except blocks coded with a single symbol: their payload is
+    //  empty but for the sizes of interleaved streams, so only blocks with a
+    //  longer payload are bounded. In context streams a byte may have a
+    //  single successor, so their blocks are bounded by the block size alone.
+    uint64_t emptyBits = (flags & FLAG_INTERLEAVED) ? 8 * (1 + 4 * (SFDecoder::MAX_STREAMS - 1)) : 0;
+    uint64_t bounded = 0;
+    index.resize(count);
+    uint64_t total = 0;
+    const uint8_t* entry = data + indexOffset + 8;
+    for (uint64_t i = 0; i < count; i++, entry += INDEX_ENTRY_SIZE) {
+        index[i].offset = getLE(entry, 8);
+        index[i].bitLength = getLE(entry + 8, 8);
+        index[i].rawSize = getLE(entry + 16, 4);
+        if (index[i].offset >= indexOffset || index[i].rawSize > blockSize) {
+            throw std::runtime_error("Invalid block index");
+        }
+        if ((flags & FLAG_CONTEXT) == 0 && index[i].bitLength > emptyBits) {
+            bounded += index[i].rawSize;
+        }
+        total += index[i].rawSize;
+    }
+    if (total != getLE(data + size - 16, 8) || total > count * blockSize || bounded > 8 * uint64_t(size)) {
+        throw std::runtime_error("Invalid block index");
+    }
+    return total;
+}
+
+#endif
@@ -0,0 +1,380 @@
+#ifndef SFCodeTable_H
+#define SFCodeTable_H
+
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <SymbolTraits.cpp>
+#include <cstdint>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+
+//  Dense prefix code over the alphabet of a symbol type: for every symbol
+//  stores whether it is present, its code (right-aligned, MSB is sent first)
+//  and the code length in bits.
+//  A table made canonical keeps its code lengths but reassigns the codes in
+//  order of length, then symbol, so it can be serialized as lengths alone.
+template <typename Symbol>
+class SFBasicCodeTable
+{
+    public:
+        static constexpr unsigned MAX_LENGTH = 64;
+        static constexpr unsigned SYMBOL_BITS = SymbolTraits<Symbol>::BITS;
+        static constexpr size_t ALPHABET_SIZE = SymbolTraits<Symbol>::ALPHABET_SIZE;
+
+        SFBasicCodeTable();
+
+        void set(Symbol symbol, uint64_t code, unsigned length);
+        void clear();
+        void canonicalize();
+        bool is_canonical() const;
+        bool has(Symbol symbol) const;
+        uint64_t get_code(Symbol symbol) const;
+        unsigned get_length(Symbol symbol) const;
+        size_t get_alphabetSize() const;
+        unsigned get_maxLength() const;
+        void encode(const Symbol* data, size_t size, BitWriter& writer) const;
+        void encode(const Symbol* data, size_t size, BitWriter* writers, unsigned streams) const;
+        uint64_t cost(const SymbolHistogram<Symbol>& histogram) const;
+        void write(std::vector<uint8_t>& output) const;
+        void write(BitWriter& writer) const;
+        size_t read(const uint8_t* data, size_t size);
+        void read(BitReader& reader);
+
+    private:
+        SymbolArray<uint64_t, ALPHABET_SIZE> codes;
+        SymbolArray<uint8_t, ALPHABET_SIZE> lengths;
+        SymbolArray<bool, ALPHABET_SIZE> present;
+        size_t alphabetSize;
+        unsigned maxLength;
+        bool canonical;
+
+        void writeLengths(BitWriter& writer) const;
+        void readLengths(BitReader& reader, size_t count);
+};
+
+using SFCodeTable = SFBasicCodeTable<uint8_t>;
+
+
+template <typename Symbol>
+SFBasicCodeTable<Symbol>::SFBasicCodeTable()
+{
+    clear();
+}
+
+//  Assigns a code to the symbol. Throws length_error if the code does not
+//  fit in 64 bits.
+//      symbol  -   symbol to assign
+//      code    -   code bits, right-aligned
+//      length  -   number of bits in the code
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::set(Symbol symbol, uint64_t code, unsigned length)
+{
+    if (length > MAX_LENGTH) {
+        throw std::length_error("Code is longer than 64 bits");
+    }
+    if (!present[symbol]) {
+        present[symbol] = true;
+        ++alphabetSize;
+    }
+    codes[symbol] = code;
+    lengths[symbol] = length;
+    canonical = false;
+    if (length > maxLength) {
+        maxLength = length;
+    }
+}
+
+//  Removes all symbols from the table
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::clear()
+{
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        codes[i] = 0;
+        lengths[i] = 0;
+        present[i] = false;
+    }
+    alphabetSize = 0;
+    maxLength = 0;
+    canonical = false;
+}
+
+//  Reassigns the codes canonically: shorter codes first, codes of the same
+//  length in symbol order, each one the previous code plus one. The lengths
+//  must satisfy the Kraft inequality, as any prefix code does.
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::canonicalize()
+{
+    uint64_t count[MAX_LENGTH + 1] = {};
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        if (present[i]) ++count[lengths[i]];
+    }
+    uint64_t next[MAX_LENGTH + 1] = {};
+    uint64_t code = 0;
+    for (unsigned length = 1; length <= maxLength; length++) {
+        code = (code + count[length - 1]) << 1;
+        next[length] = code;
+    }
+    for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+        if (present[i] && lengths[i] > 0) {
+            codes[i] = next[lengths[i]]++;
+        }
+    }
+    canonical = true;
+}
+
+//  Returns true if the codes were assigned by canonicalize()
+template <typename Symbol>
+bool SFBasicCodeTable<Symbol>::is_canonical() const
+{
+    return canonical;
+}
+
+template <typename Symbol>
+bool SFBasicCodeTable<Symbol>::has(Symbol symbol) const
+{
+    return present[symbol];
+}
+
+template <typename Symbol>
+uint64_t SFBasicCodeTable<Symbol>::get_code(Symbol symbol) const
+{
+    return codes[symbol];
+}
+
+template <typename Symbol>
+unsigned SFBasicCodeTable<Symbol>::get_length(Symbol symbol) const
+{
+    return lengths[symbol];
+}
+
+//  Returns the number of present symbols
+template <typename Symbol>
+size_t SFBasicCodeTable<Symbol>::get_alphabetSize() const
+{
+    return alphabetSize;
+}
+
+//  Returns the length of the longest code
+template <typename Symbol>
+unsigned SFBasicCodeTable<Symbol>::get_maxLength() const
+{
+    return maxLength;
+}
+
+//  Appends the codes of the given symbols to the writer by direct indexing.
+//  Every symbol of data must be present in the table.
+//      data    -   symbols to encode
+//      size    -   number of symbols
+//      writer  -   destination bitstream
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::encode(const Symbol* data, size_t size, BitWriter& writer) const
+{
+    for (size_t i = 0; i < size; i++) {
+        writer.write(codes[data[i]], lengths[data[i]]);
+    }
+}
+
+//  Appends the codes of the given symbols to interleaved streams: symbol i
+//  goes to writers[i % streams], so the streams can be decoded concurrently.
+//      data    -   symbols to encode
+//      size    -   number of symbols
+//      writers -   destination bitstreams, one per stream
+//      streams -   number of streams, at least one
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::encode(const Symbol* data, size_t size, BitWriter* writers,
+                                      unsigned streams) const
+{
+    size_t i = 0;
+    for (; i + streams <= size; i += streams) {
+        for (unsigned s = 0; s < streams; s++) {
+            writers[s].write(codes[data[i + s]], lengths[data[i + s]]);
+        }
+    }
+    for (unsigned s = 0; i < size; i++, s++) {
+        writers[s].write(codes[data[i]], lengths[data[i]]);
+    }
+}
+
+//  Returns the size in bits of the counted symbols encoded with the table,
+//  or the largest value if the table lacks one of them
+template <typename Symbol>
+uint64_t SFBasicCodeTable<Symbol>::cost(const SymbolHistogram<Symbol>& histogram) const
+{
+    const uint64_t* counts = histogram.get_counts();
+    uint64_t bits = 0;
+    for (size_t symbol = 0; symbol < ALPHABET_SIZE; symbol++) {
+        if (counts[symbol] == 0) {
+            continue;
+        }
+        if (!present[symbol]) {
+            return UINT64_MAX;
+        }
+        bits += counts[symbol] * lengths[symbol];
+    }
+    return bits;
+}
+
+//  Appends the serialized table to output, padded to a whole byte: a
+//  canonical flag bit and the alphabet size in SYMBOL_BITS + 1 bits, then
+//  -   for other tables, every present symbol in SYMBOL_BITS bits, its
+//      length in 7 bits and the code itself;
+//  -   for canonical tables, only the code lengths (see writeLengths).
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::write(std::vector<uint8_t>& output) const
+{
+    BitWriter writer;
+    write(writer);
+    writer.finish();
+    output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+}
+
+//  Appends the serialized table to the writer without padding, so a caller
+//  can reuse one writer and its buffer for many tables.
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::write(BitWriter& writer) const
+{
+    writer.write(canonical, 1);
+    writer.write(alphabetSize, SYMBOL_BITS + 1);
+    if (canonical) {
+        writeLengths(writer);
+    } else {
+        for (size_t i = 0; i < ALPHABET_SIZE; i++) {
+            if (present[i]) {
+                writer.write(i, SYMBOL_BITS);
+                writer.write(lengths[i], 7);
+                writer.write(codes[i], lengths[i]);
+            }
+        }
+    }
+}
+
+//  Replaces the table with one serialized by write() and returns the number
+//  of bytes read. Throws runtime_error if the data is truncated or invalid.
+//      data    -   serialized table
+//      size    -   number of bytes available
+template <typename Symbol>
+size_t SFBasicCodeTable<Symbol>::read(const uint8_t* data, size_t size)
+{
+    BitReader reader(data, size);
+    read(reader);
+    size_t bytes = (reader.get_bitposition() + 7) / 8;
+    if (bytes > size) {
+        throw std::runtime_error("Truncated code table");
+    }
+    return bytes;
+}
+
+//  Replaces the table with one written by write(BitWriter&) at the position
+//  of the reader. Throws runtime_error if the table is invalid; the caller
+//  checks that the reader did not run past its data.
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::read(BitReader& reader)
+{
+    clear();
+    bool isCanonical = reader.read(1);
+    size_t count = reader.read(SYMBOL_BITS + 1);
+    if (count > ALPHABET_SIZE) {
+        throw std::runtime_error("Invalid code table");
+    }
+    if (isCanonical) {
+        readLengths(reader, count);
+        if (alphabetSize != count) {
+            throw std::runtime_error("Invalid code table");
+        }
+    } else {
+        for (size_t i = 0; i < count; i++) {
+            Symbol symbol = static_cast<Symbol>(reader.read(SYMBOL_BITS));
+            unsigned length = reader.read(7);
+            if (length > MAX_LENGTH || present[symbol]) {
+                throw std::runtime_error("Invalid code table");
+            }
+            set(symbol, reader.read(length), length);
+        }
+    }
+}
+
+//  Writes the lengths of a canonical table, each as a nibble: the length
+//  itself up to 14, or 15 followed by the length minus 15 in 6 bits. A mode
+//  bit selects the smaller of two layouts:
+//  -   dense: the first and last present symbols in SYMBOL_BITS bits each,
+//      then a length for every symbol between them, 0 for absent ones;
+//  -   sparse: every present symbol in SYMBOL_BITS bits followed by its
+//      length.
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::writeLengths(BitWriter& writer) const
+{
+    const int LAST = int(ALPHABET_SIZE) - 1;
+    int first = 0, last = LAST;
+    while (first < LAST && !present[first]) first++;
+    while (last > 0 && !present[last]) last--;
+    bool dense = first <= last &&
+                 2 * SYMBOL_BITS + (last - first + 1) * 4 < int(alphabetSize) * (SYMBOL_BITS + 4);
+
+    writer.write(!dense, 1);
+    if (dense) {
+        writer.write(first, SYMBOL_BITS);
+        writer.write(last, SYMBOL_BITS);
+    }
+    for (int i = dense ? first : 0; i <= (dense ? last : LAST); i++) {
+        if (!dense && !present[i]) {
+            continue;
+        }
+        if (!dense) {
+            writer.write(i, SYMBOL_BITS);
+        }
+        unsigned length = present[i] ? lengths[i] : 0;
+        if (length < 15) {
+            writer.write(length, 4);
+        } else {
+            writer.write(15, 4);
+            writer.write(length - 15, 6);
+        }
+    }
+}
+
+//  Reads the lengths written by writeLengths and assigns canonical codes.
+//  Throws runtime_error if the lengths do not form a prefix code.
+template <typename Symbol>
+void SFBasicCodeTable<Symbol>::readLengths(BitReader& reader, size_t count)
+{
+    bool dense = !reader.read(1);
+    int first = 0, last = int(count) - 1;
+    if (dense) {
+        first = reader.read(SYMBOL_BITS);
+        last = reader.read(SYMBOL_BITS);
+    }
+    uint64_t lengthCount[MAX_LENGTH + 1] = {};
+    for (int i = first; i <= last; i++) {
+        int symbol = dense ? i : int(reader.read(SYMBOL_BITS));
+        unsigned length = reader.read(4);
+        if (length == 15) {
+            length += reader.read(6);
+        }
+        if (length > MAX_LENGTH || (!dense && present[symbol]) ||
+            (length == 0 && (!dense && count != 1))) {
+            throw std::runtime_error("Invalid code table");
+        }
+        if (length != 0 || !dense) {
+            set(symbol, 0, length);
+            ++lengthCount[length];
+        }
+    }
+    if (lengthCount[0] != 0 && alphabetSize != 1) {
+        throw std::runtime_error("Invalid code table");
+    }
+
+    //  every length must fit into the codes left free by the shorter ones
+    uint64_t free = 1;
+    for (unsigned length = 1; length <= MAX_LENGTH; length++) {
+        free *= 2;
+        if (lengthCount[length] > free) {
+            throw std::runtime_error("Invalid code table");
+        }
+        free -= lengthCount[length];
+        if (free > ALPHABET_SIZE) free = ALPHABET_SIZE;
+    }
+    canonicalize();
+}
+
+#endif
@@ -1,193 +1,180 @@
-#include <LinkedList.cpp>
-#include <MyMap.cpp>
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <SFCodeTable.cpp>
+#include <SFDecoder.cpp>
+#include <SFTableBuilder.cpp>
+#include <SymbolTraits.cpp>
 #include <iostream>
 #include <bitset>
-
-//  Shannon - Fano encoder class
-class SFCoder
+#include <string>
+#include <type_traits>
+#include <vector>
+
+//  Shannon - Fano encoder class, templated on the symbol type.
+//  SFCoder codes the bytes of a string; SFCoder16 codes 16-bit symbols, so
+//  a text can be coded as byte pairs or as the ids of a token dictionary to
+//  capture redundancy above the byte level. Sizes are counted in bits, so
+//  the compression ratio is relative to SYMBOL_BITS bits per symbol.
+template <typename Symbol>
+class SFBasicCoder
 {
     public:
-        SFCoder(const std::string& originalText);
-        ~SFCoder();
+        static constexpr unsigned SYMBOL_BITS = SymbolTraits<Symbol>::BITS;
+        using String = typename std::conditional<sizeof(Symbol) == 1, std::string,
+                                                 std::vector<Symbol>>::type;
+
+        SFBasicCoder(const String& originalText);
+        ~SFBasicCoder();
 
         void print_ftable();
         float compression_ratio();
         std::string get_encoded();
-        std::string get_decoded();
+        String get_decoded();
+        const std::vector<uint8_t>& get_payload();
+        uint64_t get_bitlength();
+        const SFBasicCodeTable<Symbol>& get_table();
+        const SymbolHistogram<Symbol>& get_histogram();
         int get_orsize();
         int get_ensize();
         
 
     private:
-        char* chars;
-        int* frequency;
-        size_t alphabetSize;
-        MyMap<char, int> mapOfChars;
+        SymbolHistogram<Symbol> histogram;
+        SFBasicTableBuilder<Symbol> builder;
 
         int originalTextLength;
         int originalSize = 0;
         int encodedSize = 0;
 
-        std::string* encodeKey;
-        std::string* encodedText;
-        std::string* decodedText;
+        SFBasicCodeTable<Symbol> table;
+        BitWriter encodedText;
+        String decodedText;
 
-        void quickSort(int* frequency, char* chars, size_t size);
-        void createEncoding(int begin, int end);
-        void encodeOriginalText(const std::string& originalText);
+        void encodeOriginalText(const String& originalText);
         void decodeEncodedText();
 };
 
+using SFCoder = SFBasicCoder<uint8_t>;
+using SFCoder16 = SFBasicCoder<uint16_t>;
 
-SFCoder::SFCoder(const std::string& originalText)
-{
-    originalTextLength = originalText.length();
-    for (int i = 0; i < originalTextLength; i++) {
-        if (!mapOfChars.has(originalText[i])) {
-            mapOfChars.insert(originalText[i], 1);
-        } else {
-            mapOfChars.addToValue(originalText[i], 1);
-        }
-    }
-
-    LinkedList<char> charsList = mapOfChars.get_keys();
-    LinkedList<int> frequencyList = mapOfChars.get_values();
 
-    alphabetSize = charsList.get_size();
-    chars = new char[alphabetSize];
-    frequency = new int[alphabetSize];
-    encodeKey = new std::string[alphabetSize];
-    encodedText = new std::string[originalTextLength];
-    decodedText = new std::string[originalTextLength];
-
-    for (int i = 0; i < alphabetSize; i++) {
-        chars[i] = charsList.at(i);
-        frequency[i] = frequencyList.at(i);
-    }
-    quickSort(frequency, chars, alphabetSize);
-    createEncoding(0, alphabetSize-1);
+template <typename Symbol>
+SFBasicCoder<Symbol>::SFBasicCoder(const String& originalText)
+{
+    originalTextLength = originalText.size();
+    histogram.add(reinterpret_cast<const Symbol*>(originalText.data()), originalTextLength);
+    builder.build(histogram, table);
     encodeOriginalText(originalText);
     decodeEncodedText();
 }
 
-SFCoder::~SFCoder()
+template <typename Symbol>
+SFBasicCoder<Symbol>::~SFBasicCoder()
 {
-    delete[] chars;
-    delete[] frequency;
-    delete[] encodeKey;
 }
 
-void SFCoder::createEncoding(int begin, int end)
+//  Packs the codes of the original text into the encodedText bitstream
+template <typename Symbol>
+void SFBasicCoder<Symbol>::encodeOriginalText(const String& originalText)
 {
-    if (begin < end) {
-
-		int left = begin, right = end;
-		int sumLeft = 0, sumRight = 0;
-
-		while (left <= right)
-			if (sumLeft <= sumRight)
-				sumLeft += frequency[left++];
-			else
-				sumRight += frequency[right--];
-
-		for (int i = left; i <= end; i++) encodeKey[i] += "1";
-		for (int i = begin; i < left; i++) encodeKey[i] += "0";
-
-		// run the recursive algorithm to left and right subarrays
-		createEncoding(left, end);
-		createEncoding(begin, left - 1);
-	}
+    table.encode(reinterpret_cast<const Symbol*>(originalText.data()), originalTextLength, encodedText);
+    encodedText.finish();
+    encodedSize = encodedText.get_bitlength();
+    originalSize = originalTextLength * SYMBOL_BITS;
 }
 
-void SFCoder::encodeOriginalText(const std::string& originalText)
+//  Decodes the packed bitstream using only the payload and the code table
+template <typename Symbol>
+void SFBasicCoder<Symbol>::decodeEncodedText()
 {
-    for (int i = 0; i < originalTextLength; i++)
-		for (int j = 0; j < alphabetSize; j++)
-			if (chars[j] == originalText[i]) {
-				encodedText[i] = encodeKey[j];
-                encodedSize += encodeKey[j].length();
-				originalSize += 8;
-				break;
-			}
+    SFBasicDecoder<Symbol> decoder(table);
+    const std::vector<uint8_t>& payload = encodedText.get_bytes();
+    decodedText.resize(originalTextLength);
+    decoder.decode(payload.data(), payload.size(), reinterpret_cast<Symbol*>(decodedText.data()),
+                   originalTextLength);
 }
 
-void SFCoder::decodeEncodedText()
-{
-    for (int i = 0; i < originalTextLength; i++)
-		for (int j = 0; j < alphabetSize; j++)
-			if (encodedText[i] == encodeKey[j]) {
-				decodedText[i] = chars[j];
-				break;
-			}
-}
 
-
-float SFCoder::compression_ratio()
+template <typename Symbol>
+float SFBasicCoder<Symbol>::compression_ratio()
 {
     return encodedSize * 1.f / originalSize;
 }
 
-void SFCoder::print_ftable()
+template <typename Symbol>
+void SFBasicCoder<Symbol>::print_ftable()
 {
     std::cout << "\nFano table:\n";
-	for (int i = 0; i < alphabetSize; i++) 
-        std::cout << chars[i] << " : " << frequency[i] << " : " << encodeKey[i] << '\n';
+	for (size_t i = 0; i < builder.get_alphabetSize(); i++) {
+        Symbol symbol = builder.get_symbol(i);
+        std::string code;
+        for (unsigned bit = table.get_length(symbol); bit > 0; bit--)
+            code += ((table.get_code(symbol) >> (bit - 1)) & 1) ? '1' : '0';
+        if (SYMBOL_BITS == 8) {
+            std::cout << static_cast<char>(symbol);
+        } else {
+            std::cout << symbol;
+        }
+        std::cout << " : " << builder.get_frequency(i) << " : " << code << '\n';
+    }
 }
 
-std::string SFCoder::get_encoded()
+//  Returns the encoded bitstream as a string of '0' and '1', for debugging
+template <typename Symbol>
+std::string SFBasicCoder<Symbol>::get_encoded()
 {
     std::string result;
-    std::string nextChar;
-    for (int i = 0; i < originalTextLength; i++) {
-        nextChar = encodedText[i];
-        result += nextChar;
+    uint64_t bitLength = encodedText.get_bitlength();
+    const std::vector<uint8_t>& bytes = encodedText.get_bytes();
+    result.reserve(bitLength);
+    for (uint64_t i = 0; i < bitLength; i++) {
+        result += ((bytes[i / 8] >> (7 - i % 8)) & 1) ? '1' : '0';
     }
     return result;
 }
 
-std::string SFCoder::get_decoded()
+template <typename Symbol>
+typename SFBasicCoder<Symbol>::String SFBasicCoder<Symbol>::get_decoded()
 {
-    std::string result;
-    std::string nextChar;
-    for (int i = 0; i < originalTextLength; i++) {
-        nextChar = decodedText[i];
-        result += nextChar;
-    }
-    return result;
+    return decodedText;
 }
 
-int SFCoder::get_ensize()
+//  Returns the packed encoded bytes, padded with zeroes up to a whole byte
+template <typename Symbol>
+const std::vector<uint8_t>& SFBasicCoder<Symbol>::get_payload()
 {
-    return encodedSize;
+    return encodedText.get_bytes();
 }
 
-int SFCoder::get_orsize()
+//  Returns the exact number of meaningful bits in the payload
+template <typename Symbol>
+uint64_t SFBasicCoder<Symbol>::get_bitlength()
 {
-    return originalSize;
+    return encodedText.get_bitlength();
 }
 
-//  Sorts relatively to Key-Value pair
-void SFCoder::quickSort(int* frequency, char* chars, size_t size)
+//  Returns the symbol frequencies of the original text
+template <typename Symbol>
+const SymbolHistogram<Symbol>& SFBasicCoder<Symbol>::get_histogram()
 {
-    if (size > 0) {
-        int begin = 0; 
-        int end = size - 1; 
-        int pivot_value = frequency[rand() % size];
-        do {
-            while (frequency[begin] > pivot_value)
-                begin++;
-            while (frequency[end] < pivot_value)
-                end--;
-            if (begin <= end) {
-                std::swap(frequency[begin], frequency[end]);
-                std::swap(chars[begin], chars[end]);
-                begin++;
-                end--;
-            }
-        } while (begin <= end);
-
-        if (begin < size) quickSort(frequency + begin, chars + begin, size - begin);
-        if (end > 0) quickSort(frequency, chars, ++end);
-    }
+    return histogram;
+}
+
+//  Returns the code table needed to decode the payload
+template <typename Symbol>
+const SFBasicCodeTable<Symbol>& SFBasicCoder<Symbol>::get_table()
+{
+    return table;
 }
 
+template <typename Symbol>
+int SFBasicCoder<Symbol>::get_ensize()
+{
+    return encodedSize;
+}
+
+template <typename Symbol>
+int SFBasicCoder<Symbol>::get_orsize()
+{
+    return originalSize;
+}
@@ -0,0 +1,205 @@
+#ifndef SFContextModel_H
+#define SFContextModel_H
+
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <SFCodeTable.cpp>
+#include <SFDecoder.cpp>
+#include <SFTableBuilder.cpp>
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+//  Order-1 model: one Shannon - Fano table per value of the preceding byte.
+//  A context gets its own table only if coding its bytes with it, plus
+//  storing it, is smaller than coding them with the shared table; the other
+//  contexts, usually the rare ones, use the shared table, which is built
+//  from their bytes alone. The first byte of a block is coded in context 0.
+//  All tables are canonical and serialized back to back without padding:
+//      own table bitmap (256 bits) | shared table | own tables by context
+//  Decoding stays table-driven: every table gets an SFDecoder whose root
+//  table is limited to DECODER_ROOT_BITS so that all of them fit in cache.
+//  The model keeps its arrays between builds; they are only allocated when
+//  the model is first used.
+class SFContextModel
+{
+    public:
+        static constexpr unsigned CONTEXTS = 256;
+        static constexpr unsigned DECODER_ROOT_BITS = 9;
+
+        SFContextModel(unsigned maxLength = SFCodeTable::MAX_LENGTH);
+
+        void build(const uint8_t* data, size_t size);
+        void encode(const uint8_t* data, size_t size, BitWriter& writer) const;
+        void write(BitWriter& writer) const;
+        size_t read(const uint8_t* data, size_t size);
+        void decode(const uint8_t* data, size_t size, uint8_t* output, size_t count) const;
+        bool has_ownTable(uint8_t context) const;
+        const SFCodeTable& get_table(uint8_t context) const;
+
+    private:
+        static constexpr unsigned SHARED = CONTEXTS;
+
+        SFTableBuilder builder;
+        std::vector<uint32_t> counts;
+        std::vector<SFCodeTable> tables;
+        std::vector<SFDecoder> decoders;
+        unsigned tableOf[CONTEXTS];
+        BitWriter scratch;
+
+        void allocate();
+        void buildTable(const ByteHistogram& histogram, SFCodeTable& table);
+};
+
+
+SFContextModel::SFContextModel(unsigned maxLength) : builder(maxLength)
+{
+    for (unsigned context = 0; context < CONTEXTS; context++) {
+        tableOf[context] = SHARED;
+    }
+}
+
+//  Chooses the tables for the given block.
+//      data    -   uncompressed bytes
+//      size    -   number of bytes, below 2^32
+void SFContextModel::build(const uint8_t* data, size_t size)
+{
+    allocate();
+    std::fill(counts.begin(), counts.end(), 0);
+    uint8_t previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        ++counts[previous * CONTEXTS + data[i]];
+        previous = data[i];
+    }
+
+    ByteHistogram all, context, shared;
+    for (unsigned symbol = 0; symbol < 256; symbol++) {
+        uint64_t total = 0;
+        for (unsigned c = 0; c < CONTEXTS; c++) total += counts[c * CONTEXTS + symbol];
+        all.add(static_cast<uint8_t>(symbol), total);
+    }
+    buildTable(all, tables[SHARED]);
+
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        context.clear();
+        for (unsigned symbol = 0; symbol < 256; symbol++) {
+            if (counts[c * CONTEXTS + symbol] != 0) {
+                context.add(static_cast<uint8_t>(symbol), counts[c * CONTEXTS + symbol]);
+            }
+        }
+        tableOf[c] = SHARED;
+        if (context.get_total() == 0) {
+            continue;
+        }
+        buildTable(context, tables[c]);
+        scratch.clear();
+        tables[c].write(scratch);
+        if (tables[c].cost(context) + scratch.get_bitlength() < tables[SHARED].cost(context)) {
+            tableOf[c] = c;
+        } else {
+            shared.add(context);
+        }
+    }
+    buildTable(shared, tables[SHARED]);
+}
+
+//  Appends the codes of the given bytes to the writer; data must be the
+//  block the model was built for
+void SFContextModel::encode(const uint8_t* data, size_t size, BitWriter& writer) const
+{
+    const SFCodeTable* table[CONTEXTS];
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        table[c] = &tables[tableOf[c]];
+    }
+    uint8_t previous = 0;
+    for (size_t i = 0; i < size; i++) {
+        writer.write(table[previous]->get_code(data[i]), table[previous]->get_length(data[i]));
+        previous = data[i];
+    }
+}
+
+//  Appends the serialized tables to the writer without padding
+void SFContextModel::write(BitWriter& writer) const
+{
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        writer.write(tableOf[c] != SHARED, 1);
+    }
+    tables[SHARED].write(writer);
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        if (tableOf[c] != SHARED) {
+            tables[c].write(writer);
+        }
+    }
+}
+
+//  Replaces the model with one serialized by write(), prepares its decoders
+//  and returns the number of bytes read, counting the padding of the last
+//  one. Throws runtime_error if the data is truncated or invalid.
+size_t SFContextModel::read(const uint8_t* data, size_t size)
+{
+    allocate();
+    BitReader reader(data, size);
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        tableOf[c] = reader.read(1) ? c : SHARED;
+    }
+    tables[SHARED].read(reader);
+    decoders[SHARED].reset(tables[SHARED], DECODER_ROOT_BITS);
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        if (tableOf[c] != SHARED) {
+            tables[c].read(reader);
+            decoders[c].reset(tables[c], DECODER_ROOT_BITS);
+        }
+    }
+    size_t bytes = (reader.get_bitposition() + 7) / 8;
+    if (bytes > size) {
+        throw std::runtime_error("Truncated code table");
+    }
+    return bytes;
+}
+
+//  Decodes count bytes from the packed bitstream into output with the
+//  tables last read. Throws runtime_error if the stream contains a bit
+//  sequence that is not a code of its context.
+void SFContextModel::decode(const uint8_t* data, size_t size, uint8_t* output, size_t count) const
+{
+    const SFDecoder* decoder[CONTEXTS];
+    for (unsigned c = 0; c < CONTEXTS; c++) {
+        decoder[c] = &decoders[tableOf[c]];
+    }
+    BitReader reader(data, size);
+    uint8_t previous = 0;
+    for (size_t i = 0; i < count; i++) {
+        previous = decoder[previous]->decodeSymbol(reader);
+        output[i] = previous;
+    }
+}
+
+//  Returns whether the context has a table of its own
+bool SFContextModel::has_ownTable(uint8_t context) const
+{
+    return tableOf[context] != SHARED;
+}
+
+//  Returns the table the bytes following the given byte are coded with
+const SFCodeTable& SFContextModel::get_table(uint8_t context) const
+{
+    return tables[tableOf[context]];
+}
+
+void SFContextModel::allocate()
+{
+    if (tables.empty()) {
+        counts.resize(CONTEXTS * CONTEXTS);
+        tables.resize(CONTEXTS + 1);
+        decoders.resize(CONTEXTS + 1);
+    }
+}
+
+void SFContextModel::buildTable(const ByteHistogram& histogram, SFCodeTable& table)
+{
+    builder.build(histogram, table);
+    table.canonicalize();
+}
+
+#endif
@@ -0,0 +1,362 @@
+#ifndef SFDecoder_H
+#define SFDecoder_H
+
+#include <BitStream.cpp>
+#include <SFCodeTable.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//  Table-driven decoder of a packed prefix-coded bitstream.
+//  The first ROOT_BITS bits of the stream index the root table; codes longer
+//  than that continue in sub-tables of at most SUB_BITS bits each, so any
+//  code up to 64 bits long is resolved in a few lookups.
+//  A payload split into interleaved streams, see SFBasicCodeTable::encode,
+//  is decoded one symbol per stream in turn, so the lookups of different
+//  streams do not wait on each other and run in parallel on the CPU.
+template <typename Symbol>
+class SFBasicDecoder
+{
+    public:
+        static constexpr unsigned ROOT_BITS = 11;
+        static constexpr unsigned SUB_BITS = 8;
+        static constexpr unsigned MAX_STREAMS = 8;
+
+        SFBasicDecoder();
+        SFBasicDecoder(const SFBasicCodeTable<Symbol>& table, unsigned maxRootBits = ROOT_BITS);
+
+        void reset(const SFBasicCodeTable<Symbol>& table, unsigned maxRootBits = ROOT_BITS);
+        Symbol decodeSymbol(BitReader& reader) const;
+
+        void decode(const uint8_t* data, size_t size, Symbol* output, size_t count) const;
+        void decode(const uint8_t* data, const size_t* offsets, unsigned streams, Symbol* output,
+                    size_t count) const;
+        std::string decode(const std::vector<uint8_t>& payload, size_t count) const;
+
+    private:
+        //  Leaf entry: symbol in value, bits consumed at this level in bits.
+        //  Link entry: sub-table offset in value, its index width in subBits.
+        //  Entries with both bits and subBits equal to zero are invalid.
+        struct Entry
+        {
+            uint32_t value;
+            uint8_t bits;
+            uint8_t subBits;
+        };
+
+        struct Code
+        {
+            uint64_t code;
+            unsigned length;
+            Symbol symbol;
+        };
+
+        //  Bit buffer of one interleaved stream: the next bytes to load and
+        //  the bufferBits valid bits at the top of buffer.
+        struct Lane
+        {
+            const uint8_t* next;
+            const uint8_t* end;
+            uint64_t buffer;
+            unsigned bufferBits;
+        };
+
+        std::vector<Entry> entries;
+        unsigned rootBits;
+        unsigned maxLength;
+        size_t alphabetSize;
+        Symbol onlySymbol;
+
+        void buildTable(size_t offset, unsigned tableBits, unsigned prefixLength,
+                        const std::vector<Code>& codes);
+        Symbol decodeNext(const Entry* table, BitReader& reader) const;
+        Entry decodeLong(const Entry* table, Entry entry, Lane& lane) const;
+        template <unsigned STREAMS>
+        size_t decodeLanes(const Entry* table, Lane* lanes, Symbol* output, size_t count) const;
+};
+
+using SFDecoder = SFBasicDecoder<uint8_t>;
+
+
+//  Creates a decoder for the empty table, which decodes only empty payloads
+template <typename Symbol>
+SFBasicDecoder<Symbol>::SFBasicDecoder()
+{
+    rootBits = 0;
+    maxLength = 0;
+    alphabetSize = 0;
+    onlySymbol = 0;
+}
+
+//  Builds the lookup tables for the given code table
+//      table       -   code table to decode
+//      maxRootBits -   width limit of the root table; a narrower root keeps
+//                      many decoders used together small
+template <typename Symbol>
+SFBasicDecoder<Symbol>::SFBasicDecoder(const SFBasicCodeTable<Symbol>& table, unsigned maxRootBits)
+{
+    reset(table, maxRootBits);
+}
+
+//  Rebuilds the lookup tables for another code table, reusing their memory
+template <typename Symbol>
+void SFBasicDecoder<Symbol>::reset(const SFBasicCodeTable<Symbol>& table, unsigned maxRootBits)
+{
+    std::vector<Code> codes;
+    entries.clear();
+    alphabetSize = table.get_alphabetSize();
+    onlySymbol = 0;
+    for (size_t i = 0; i < SFBasicCodeTable<Symbol>::ALPHABET_SIZE; i++) {
+        Symbol symbol = static_cast<Symbol>(i);
+        if (table.has(symbol)) {
+            codes.push_back({table.get_code(symbol), table.get_length(symbol), symbol});
+            onlySymbol = symbol;
+        }
+    }
+
+    maxLength = table.get_maxLength();
+    rootBits = maxLength < maxRootBits ? maxLength : maxRootBits;
+    if (alphabetSize > 1) {
+        entries.resize(size_t(1) << rootBits, Entry{0, 0, 0});
+        buildTable(0, rootBits, 0, codes);
+    }
+}
+
+//  Fills the table of 2^tableBits entries at offset with the codes sharing
+//  the same first prefixLength bits, creating sub-tables for longer codes.
+template <typename Symbol>
+void SFBasicDecoder<Symbol>::buildTable(size_t offset, unsigned tableBits, unsigned prefixLength,
+                           const std::vector<Code>& codes)
+{
+    unsigned tableEnd = prefixLength + tableBits;
+    std::vector<std::vector<Code>> longer(size_t(1) << tableBits);
+
+    for (const Code& c : codes) {
+        unsigned rest = c.length - prefixLength;
+        if (c.length <= tableEnd) {
+            uint64_t bits = c.code & ((rest == 64) ? ~0ull : (1ull << rest) - 1);
+            size_t first = bits << (tableBits - rest);
+            size_t span = size_t(1) << (tableBits - rest);
+            for (size_t i = first; i < first + span; i++) {
+                entries[offset + i] = Entry{c.symbol, static_cast<uint8_t>(rest), 0};
+            }
+        } else {
+            size_t index = (c.code >> (c.length - tableEnd)) & ((size_t(1) << tableBits) - 1);
+            longer[index].push_back(c);
+        }
+    }
+
+    for (size_t i = 0; i < longer.size(); i++) {
+        if (longer[i].empty()) continue;
+        unsigned maxLength = 0;
+        for (const Code& c : longer[i]) {
+            if (c.length > maxLength) maxLength = c.length;
+        }
+        unsigned subBits = maxLength - tableEnd < SUB_BITS ? maxLength - tableEnd : SUB_BITS;
+        size_t subOffset = entries.size();
+        entries.resize(subOffset + (size_t(1) << subBits), Entry{0, 0, 0});
+        entries[offset + i] = Entry{static_cast<uint32_t>(subOffset),
+                                    static_cast<uint8_t>(tableBits),
+                                    static_cast<uint8_t>(subBits)};
+        buildTable(subOffset, subBits, tableEnd, longer[i]);
+    }
+}
+
+//  Decodes count symbols from the packed bitstream into output. Throws
+//  runtime_error if the stream contains a bit sequence that is not a code.
+//      data    -   packed bitstream
+//      size    -   size of the bitstream in bytes
+//      output  -   buffer of at least count bytes
+//      count   -   number of symbols to decode
+template <typename Symbol>
+void SFBasicDecoder<Symbol>::decode(const uint8_t* data, size_t size, Symbol* output, size_t count) const
+{
+    if (count == 0) {
+        return;
+    }
+    if (alphabetSize == 0) {
+        throw std::runtime_error("Empty code table");
+    }
+    if (alphabetSize == 1) {
+        for (size_t i = 0; i < count; i++) output[i] = onlySymbol;
+        return;
+    }
+
+    BitReader reader(data, size);
+    const Entry* table = entries.data();
+    for (size_t i = 0; i < count; i++) {
+        output[i] = decodeNext(table, reader);
+    }
+}
+
+//  Decodes count symbols from interleaved streams into output: symbol i is
+//  read from stream i % streams. Throws runtime_error if a stream contains a
+//  bit sequence that is not a code.
+//      data    -   packed streams
+//      offsets -   streams + 1 offsets into data; stream s occupies the bytes
+//                  from offsets[s] to offsets[s + 1]
+//      streams -   number of streams, from 1 to MAX_STREAMS
+//      output  -   buffer of at least count symbols
+//      count   -   number of symbols to decode
+template <typename Symbol>
+void SFBasicDecoder<Symbol>::decode(const uint8_t* data, const size_t* offsets, unsigned streams,
+                                    Symbol* output, size_t count) const
+{
+    if (streams == 0 || streams > MAX_STREAMS) {
+        throw std::invalid_argument("Invalid stream count");
+    }
+    if (count == 0) {
+        return;
+    }
+    if (alphabetSize == 0) {
+        throw std::runtime_error("Empty code table");
+    }
+    if (alphabetSize == 1) {
+        for (size_t i = 0; i < count; i++) output[i] = onlySymbol;
+        return;
+    }
+
+    Lane lanes[MAX_STREAMS];
+    for (unsigned s = 0; s < streams; s++) {
+        lanes[s] = Lane{data + offsets[s], data + offsets[s + 1], 0, 0};
+    }
+    const Entry* table = entries.data();
+    size_t i = 0;
+    switch (streams) {
+        case 1: i = decodeLanes<1>(table, lanes, output, count); break;
+        case 2: i = decodeLanes<2>(table, lanes, output, count); break;
+        case 3: i = decodeLanes<3>(table, lanes, output, count); break;
+        case 4: i = decodeLanes<4>(table, lanes, output, count); break;
+        case 5: i = decodeLanes<5>(table, lanes, output, count); break;
+        case 6: i = decodeLanes<6>(table, lanes, output, count); break;
+        case 7: i = decodeLanes<7>(table, lanes, output, count); break;
+        case 8: i = decodeLanes<8>(table, lanes, output, count); break;
+    }
+
+    //  the rest one symbol at a time, each stream continuing from the bit
+    //  its lane stopped at
+    BitReader readers[MAX_STREAMS];
+    for (unsigned s = 0; s < streams; s++) {
+        size_t bit = size_t(lanes[s].next - data - offsets[s]) * 8 - lanes[s].bufferBits;
+        const uint8_t* start = data + offsets[s] + bit / 8;
+        readers[s] = BitReader(start, lanes[s].end - start);
+        if (bit % 8 != 0) {
+            readers[s].read(bit % 8);
+        }
+    }
+    for (unsigned s = 0; i < count; i++, s = (s + 1) % streams) {
+        output[i] = decodeNext(table, readers[s]);
+    }
+}
+
+//  Decodes whole rounds of STREAMS symbols while every stream has 8 bytes
+//  left and returns the number of symbols decoded. Each round refills the
+//  bit buffers of all streams without branches, then decodes as many
+//  symbols per stream as 56 bits surely hold. The lanes are copied to
+//  locals so their state stays in registers across the stores to output.
+template <typename Symbol>
+template <unsigned STREAMS>
+size_t SFBasicDecoder<Symbol>::decodeLanes(const Entry* table, Lane* lanes, Symbol* output,
+                                           size_t count) const
+{
+    const unsigned shift = 64 - rootBits;
+    const unsigned perRefill = maxLength <= 56 ? 56 / maxLength : 0;
+    Lane local[STREAMS];
+    for (unsigned s = 0; s < STREAMS; s++) local[s] = lanes[s];
+
+    size_t i = 0;
+    while (perRefill != 0 && i + STREAMS * perRefill <= count) {
+        bool refillable = true;
+        for (unsigned s = 0; s < STREAMS; s++) {
+            refillable &= local[s].end - local[s].next >= 8;
+        }
+        if (!refillable) {
+            break;
+        }
+        for (unsigned s = 0; s < STREAMS; s++) {
+            uint64_t word = 0;
+            for (unsigned k = 0; k < 8; k++) {
+                word = (word << 8) | local[s].next[k];
+            }
+            local[s].buffer |= word >> local[s].bufferBits;
+            local[s].next += (63 - local[s].bufferBits) / 8;
+            local[s].bufferBits |= 56;
+        }
+        for (unsigned round = 0; round < perRefill; round++) {
+            for (unsigned s = 0; s < STREAMS; s++) {
+                Entry entry = table[local[s].buffer >> shift];
+                if (entry.subBits != 0 || entry.bits == 0) {
+                    entry = decodeLong(table, entry, local[s]);
+                }
+                local[s].buffer <<= entry.bits;
+                local[s].bufferBits -= entry.bits;
+                output[i + round * STREAMS + s] = static_cast<Symbol>(entry.value);
+            }
+        }
+        i += STREAMS * perRefill;
+    }
+
+    for (unsigned s = 0; s < STREAMS; s++) lanes[s] = local[s];
+    return i;
+}
+
+//  Follows a root entry of a lane to the leaf of its code in the sub-tables,
+//  consuming the bits of every level but the last. Kept out of line so the
+//  rare long codes do not weigh on the fast path.
+template <typename Symbol>
+typename SFBasicDecoder<Symbol>::Entry
+SFBasicDecoder<Symbol>::decodeLong(const Entry* table, Entry entry, Lane& lane) const
+{
+    while (entry.subBits != 0) {
+        lane.buffer <<= entry.bits;
+        lane.bufferBits -= entry.bits;
+        entry = table[entry.value + (lane.buffer >> (64 - entry.subBits))];
+    }
+    if (entry.bits == 0) {
+        throw std::runtime_error("Invalid code in bitstream");
+    }
+    return entry;
+}
+
+//  Decodes and consumes one symbol with the lookup tables, which must not
+//  be empty
+template <typename Symbol>
+inline Symbol SFBasicDecoder<Symbol>::decodeNext(const Entry* table, BitReader& reader) const
+{
+    Entry entry = table[reader.peek(rootBits)];
+    while (entry.subBits != 0) {
+        reader.consume(entry.bits);
+        entry = table[entry.value + reader.peek(entry.subBits)];
+    }
+    if (entry.bits == 0) {
+        throw std::runtime_error("Invalid code in bitstream");
+    }
+    reader.consume(entry.bits);
+    return static_cast<Symbol>(entry.value);
+}
+
+//  Decodes and consumes one symbol at the position of the reader. Throws
+//  runtime_error on a bit sequence that is not a code or an empty table.
+template <typename Symbol>
+inline Symbol SFBasicDecoder<Symbol>::decodeSymbol(BitReader& reader) const
+{
+    if (entries.empty()) {
+        if (alphabetSize == 0) {
+            throw std::runtime_error("Empty code table");
+        }
+        return onlySymbol;
+    }
+    return decodeNext(entries.data(), reader);
+}
+
+template <typename Symbol>
+std::string SFBasicDecoder<Symbol>::decode(const std::vector<uint8_t>& payload, size_t count) const
+{
+    static_assert(sizeof(Symbol) == 1, "Only bytes decode to a string");
+    std::string result(count, '\0');
+    decode(payload.data(), payload.size(), reinterpret_cast<uint8_t*>(&result[0]), count);
+    return result;
+}
+
+#endif
@@ -0,0 +1,263 @@
+#ifndef SFDictionary_H
+#define SFDictionary_H
+
+#include <BitStream.cpp>
+#include <ByteHistogram.cpp>
+#include <SFCodeTable.cpp>
+#include <SFDecoder.cpp>
+#include <SFTableBuilder.cpp>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+//  Bytes of one message of a batch
+struct SFSpan
+{
+    const uint8_t* data;
+    size_t size;
+};
+
+//  Code table trained once on a sample corpus and shared by many short
+//  messages, so no message pays for a histogram, a table build or a stored
+//  table. Every byte value gets one extra count during training, so
+//  messages may contain bytes the samples did not.
+//  Dictionary layout:
+//      "SFD\x1A" | u8 version | canonical code table
+//  Message layout:
+//      varint rawSize | payload
+//  The size is a little-endian base-128 varint; the payload is padded to a
+//  whole byte. Messages carry nothing else: they can only be decoded with
+//  the dictionary that encoded them.
+//  The batch functions write all messages of a batch into one buffer and
+//  reuse their buffers between calls.
+class SFDictionary
+{
+    public:
+        static constexpr uint8_t VERSION = 1;
+        static constexpr unsigned DEFAULT_MAX_LENGTH = 24;
+
+        SFDictionary();
+
+        void train(const SFSpan* samples, size_t count, unsigned maxLength = DEFAULT_MAX_LENGTH);
+        void train(const ByteHistogram& histogram, unsigned maxLength = DEFAULT_MAX_LENGTH);
+        void write(std::vector<uint8_t>& output) const;
+        size_t read(const uint8_t* data, size_t size);
+        const SFCodeTable& get_table() const;
+
+        void encode(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+        size_t decode(const uint8_t* data, size_t size, std::vector<uint8_t>& output) const;
+        void encodeBatch(const SFSpan* messages, size_t count, std::vector<uint8_t>& output,
+                         std::vector<SFSpan>& encoded);
+        void decodeBatch(const SFSpan* messages, size_t count, std::vector<uint8_t>& output,
+                         std::vector<SFSpan>& decoded);
+
+    private:
+        SFCodeTable table;
+        std::unique_ptr<SFDecoder> decoder;
+        BitWriter writer;
+        std::vector<size_t> offsets;
+
+        void setTable(const SFCodeTable& table);
+        size_t readSize(const uint8_t* data, size_t size, uint64_t& rawSize) const;
+        void checkTrained() const;
+};
+
+
+SFDictionary::SFDictionary()
+{
+}
+
+//  Trains the dictionary on the given sample messages.
+//      samples     -   sample messages
+//      count       -   number of samples
+//      maxLength   -   longest code, from SFTableBuilder::MIN_MAX_LENGTH to
+//                      SFCodeTable::MAX_LENGTH bits
+void SFDictionary::train(const SFSpan* samples, size_t count, unsigned maxLength)
+{
+    ByteHistogram histogram;
+    for (size_t i = 0; i < count; i++) {
+        histogram.add(samples[i].data, samples[i].size);
+    }
+    train(histogram, maxLength);
+}
+
+//  Trains the dictionary on the byte frequencies of a sample corpus
+void SFDictionary::train(const ByteHistogram& histogram, unsigned maxLength)
+{
+    ByteHistogram smoothed = histogram;
+    for (int symbol = 0; symbol < 256; symbol++) {
+        smoothed.add(static_cast<uint8_t>(symbol), 1);
+    }
+    SFCodeTable trained;
+    SFTableBuilder(maxLength).build(smoothed, trained);
+    trained.canonicalize();
+    setTable(trained);
+}
+
+//  Appends the serialized dictionary to output
+void SFDictionary::write(std::vector<uint8_t>& output) const
+{
+    checkTrained();
+    const uint8_t magic[4] = {'S', 'F', 'D', 0x1A};
+    output.insert(output.end(), magic, magic + 4);
+    output.push_back(VERSION);
+    table.write(output);
+}
+
+//  Replaces the dictionary with one serialized by write() and returns the
+//  number of bytes read. Throws runtime_error if the data is not a
+//  dictionary or its table does not cover every byte value.
+size_t SFDictionary::read(const uint8_t* data, size_t size)
+{
+    if (size < 5 || data[0] != 'S' || data[1] != 'F' || data[2] != 'D' || data[3] != 0x1A) {
+        throw std::runtime_error("Not an SFCoder dictionary");
+    }
+    if (data[4] != VERSION) {
+        throw std::runtime_error("Unsupported dictionary version");
+    }
+    SFCodeTable stored;
+    size_t length = stored.read(data + 5, size - 5);
+    if (stored.get_alphabetSize() != 256) {
+        throw std::runtime_error("Invalid dictionary table");
+    }
+    setTable(stored);
+    return 5 + length;
+}
+
+//  Returns the trained code table
+const SFCodeTable& SFDictionary::get_table() const
+{
+    return table;
+}
+
+//  Appends one encoded message to output.
+//      data    -   message bytes
+//      size    -   number of bytes
+//      output  -   destination buffer
+void SFDictionary::encode(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    checkTrained();
+    uint64_t rawSize = size;
+    do {
+        output.push_back(static_cast<uint8_t>((rawSize & 0x7F) | (rawSize > 0x7F ? 0x80 : 0)));
+        rawSize >>= 7;
+    } while (rawSize != 0);
+
+    writer.clear();
+    table.encode(data, size, writer);
+    writer.finish();
+    output.insert(output.end(), writer.get_bytes().begin(), writer.get_bytes().end());
+}
+
+//  Decodes one whole encoded message, appending it to output, and returns
+//  its size. Throws runtime_error if the message is truncated or corrupted.
+//      data    -   encoded message
+//      size    -   size of the encoded message in bytes
+//      output  -   destination buffer
+size_t SFDictionary::decode(const uint8_t* data, size_t size, std::vector<uint8_t>& output) const
+{
+    checkTrained();
+    uint64_t rawSize;
+    size_t position = readSize(data, size, rawSize);
+    size_t offset = output.size();
+    output.resize(offset + rawSize);
+    decoder->decode(data + position, size - position, output.data() + offset, rawSize);
+    return rawSize;
+}
+
+//  Encodes a batch of messages one after another into output and points
+//  every entry of encoded at the bytes of the corresponding message.
+//      messages    -   messages to encode
+//      count       -   number of messages
+//      output      -   replaced by the encoded messages
+//      encoded     -   replaced by count spans into output
+void SFDictionary::encodeBatch(const SFSpan* messages, size_t count, std::vector<uint8_t>& output,
+                               std::vector<SFSpan>& encoded)
+{
+    output.clear();
+    offsets.resize(count + 1);
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = output.size();
+        encode(messages[i].data, messages[i].size, output);
+    }
+    offsets[count] = output.size();
+
+    encoded.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        encoded[i] = SFSpan{output.data() + offsets[i], offsets[i + 1] - offsets[i]};
+    }
+}
+
+//  Decodes a batch of encoded messages into output and points every entry
+//  of decoded at the bytes of the corresponding message. The sizes are read
+//  first, so output is resized once and every message is decoded in place.
+//  Throws runtime_error if a message is truncated or corrupted.
+//      messages    -   whole encoded messages
+//      count       -   number of messages
+//      output      -   replaced by the decoded messages
+//      decoded     -   replaced by count spans into output
+void SFDictionary::decodeBatch(const SFSpan* messages, size_t count, std::vector<uint8_t>& output,
+                               std::vector<SFSpan>& decoded)
+{
+    checkTrained();
+    offsets.resize(count + 1);
+    offsets[0] = 0;
+    for (size_t i = 0; i < count; i++) {
+        uint64_t rawSize;
+        readSize(messages[i].data, messages[i].size, rawSize);
+        offsets[i + 1] = offsets[i] + rawSize;
+    }
+    output.resize(offsets[count]);
+
+    decoded.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        uint64_t rawSize;
+        size_t position = readSize(messages[i].data, messages[i].size, rawSize);
+        decoder->decode(messages[i].data + position, messages[i].size - position,
+                        output.data() + offsets[i], rawSize);
+        decoded[i] = SFSpan{output.data() + offsets[i], size_t(rawSize)};
+    }
+}
+
+void SFDictionary::setTable(const SFCodeTable& table)
+{
+    this->table = table;
+    decoder.reset(new SFDecoder(table));
+}
+
+//  Reads the size of an encoded message and returns the length of the
+//  varint. A tenth varint byte may only hold bit 63. Every code is at least
+//  one bit long, so a payload of n bytes holds at most 8n symbols; larger
+//  sizes are rejected as corrupted.
+size_t SFDictionary::readSize(const uint8_t* data, size_t size, uint64_t& rawSize) const
+{
+    rawSize = 0;
+    size_t position = 0;
+    for (unsigned shift = 0; ; shift += 7) {
+        if (position == size || shift > 63) {
+            throw std::runtime_error("Truncated message");
+        }
+        uint8_t byte = data[position++];
+        if (shift == 63 && (byte & 0xFE) != 0) {
+            throw std::runtime_error("Invalid message size");
+        }
+        rawSize |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    if (rawSize > 8 * uint64_t(size - position)) {
+        throw std::runtime_error("Truncated message");
+    }
+    return position;
+}
+
+void SFDictionary::checkTrained() const
+{
+    if (!decoder) {
+        throw std::logic_error("Dictionary is not trained");
+    }
+}
+
+#endif
@@ -0,0 +1,195 @@
+#ifndef SFEncoder_H
+#define SFEncoder_H
+
+#include <SFAdaptiveTable.cpp>
+#include <SFBlock.cpp>
+#include <SFSink.cpp>
+#include <ThreadPool.cpp>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+//  Streaming Shannon - Fano encoder.
+//  Input passed to update() is cut into blocks of options.blockSize bytes;
+//  every block gets its own code table and is written to the sink as soon as
+//  it is complete, so memory use is bounded by the block size no matter how
+//  large the input is. finish() flushes the last partial block and writes
+//  the end marker followed by the block index.
+//  With options.threads above one, up to BATCH_PER_THREAD blocks per thread
+//  are encoded concurrently on a thread pool and written in input order.
+//  With options.adaptive, a block carries a code table only when
+//  SFAdaptiveTable finds one worth its size; the tables of a batch are chosen
+//  in order once its histograms are counted, then the blocks are encoded
+//  concurrently as before. With options.contextModel, every block carries
+//  order-1 context tables instead of a single table.
+class SFEncoder
+{
+    public:
+        static constexpr unsigned BATCH_PER_THREAD = 2;
+
+        SFEncoder(SFSink& sink, const SFOptions& options = SFOptions());
+
+        void update(const uint8_t* data, size_t size);
+        void finish();
+
+    private:
+        struct Span
+        {
+            const uint8_t* data;
+            size_t size;
+        };
+
+        SFSink& sink;
+        SFOptions options;
+        std::unique_ptr<ThreadPool> pool;
+        std::vector<SFBlockCoder> coders;
+        std::vector<std::vector<uint8_t>> outputs;
+        std::vector<Span> spans;
+        SFAdaptiveTable selector;
+        std::vector<ByteHistogram> histograms;
+        std::vector<SFCodeTable> tables;
+        std::vector<uint8_t> newTables;
+        std::vector<uint8_t> block;
+        std::vector<SFBlockInfo> index;
+        uint64_t written;
+        bool finished;
+
+        void writeHeader();
+        void writeBlocks();
+};
+
+
+SFEncoder::SFEncoder(SFSink& sink, const SFOptions& options)
+    : sink(sink), options(options), selector(options)
+{
+    if (options.blockSize == 0 || options.blockSize > SFBlockCoder::MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+    SFBlockCoder::get_flags(options);
+    written = 0;
+    finished = false;
+    unsigned threads = options.threads > 1 ? options.threads : 1;
+    if (threads > 1) {
+        pool.reset(new ThreadPool(threads));
+    }
+    coders.assign(threads, SFBlockCoder(options));
+    outputs.resize(threads > 1 ? threads * BATCH_PER_THREAD : 1);
+    if (options.adaptive) {
+        histograms.resize(outputs.size());
+        tables.resize(outputs.size());
+        newTables.resize(outputs.size());
+    }
+}
+
+//  Adds input bytes. Whole blocks are encoded straight from data; only the
+//  remainder is copied into the pending block.
+void SFEncoder::update(const uint8_t* data, size_t size)
+{
+    if (finished) {
+        throw std::logic_error("Encoder is finished");
+    }
+    if (!block.empty()) {
+        size_t take = options.blockSize - block.size();
+        if (take > size) take = size;
+        block.insert(block.end(), data, data + take);
+        data += take;
+        size -= take;
+        if (block.size() < options.blockSize) {
+            return;
+        }
+        spans.push_back({block.data(), block.size()});
+    }
+    while (size >= options.blockSize) {
+        if (spans.size() == outputs.size()) {
+            writeBlocks();
+        }
+        spans.push_back({data, options.blockSize});
+        data += options.blockSize;
+        size -= options.blockSize;
+    }
+    writeBlocks();
+    block.clear();
+    block.insert(block.end(), data, data + size);
+}
+
+//  Encodes the pending partial block and writes the end marker and index
+void SFEncoder::finish()
+{
+    if (finished) {
+        return;
+    }
+    writeHeader();
+    if (!block.empty()) {
+        spans.push_back({block.data(), block.size()});
+        writeBlocks();
+        block.clear();
+    }
+    std::vector<uint8_t>& output = outputs[0];
+    output.clear();
+    SFBlockCoder::writeEnd(output, index, written);
+    sink.write(output.data(), output.size());
+    finished = true;
+}
+
+//  Encodes the collected spans, concurrently if there is a pool, and writes
+//  them to the sink in order
+void SFEncoder::writeBlocks()
+{
+    if (spans.empty()) {
+        return;
+    }
+    writeHeader();
+    size_t first = index.size();
+    index.resize(first + spans.size());
+    auto forEachSpan = [this](const std::function<void(size_t, unsigned)>& job) {
+        if (pool && spans.size() > 1) {
+            pool->run(spans.size(), job);
+        } else {
+            for (size_t i = 0; i < spans.size(); i++) job(i, 0);
+        }
+    };
+
+    if (options.adaptive) {
+        forEachSpan([this](size_t i, unsigned) {
+            histograms[i].clear();
+            histograms[i].add(spans[i].data, spans[i].size);
+        });
+        for (size_t i = 0; i < spans.size(); i++) {
+            newTables[i] = selector.update(histograms[i]);
+            tables[i] = selector.get_table();
+        }
+    }
+    forEachSpan([this, first](size_t i, unsigned worker) {
+        outputs[i].clear();
+        if (options.adaptive) {
+            index[first + i].bitLength = coders[worker].encode(spans[i].data, spans[i].size, tables[i],
+                                                               newTables[i], outputs[i]);
+        } else {
+            index[first + i].bitLength = coders[worker].encode(spans[i].data, spans[i].size, outputs[i]);
+        }
+        index[first + i].rawSize = spans[i].size;
+    });
+    for (size_t i = 0; i < spans.size(); i++) {
+        index[first + i].offset = written;
+        sink.write(outputs[i].data(), outputs[i].size());
+        written += outputs[i].size();
+    }
+    spans.clear();
+}
+
+//  Writes the stream header before the first block
+void SFEncoder::writeHeader()
+{
+    if (written != 0) {
+        return;
+    }
+    std::vector<uint8_t>& output = outputs[0];
+    output.clear();
+    SFBlockCoder::writeHeader(output, options);
+    sink.write(output.data(), output.size());
+    written = output.size();
+}
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef SFEncoderContext_H
+#define SFEncoderContext_H
+
+#include <ByteHistogram.cpp>
+#include <SFAdaptiveTable.cpp>
+#include <SFBlock.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//  Reusable compressor for many independent messages held in memory.
+//  compress() replaces the contents of output with a complete stream in the
+//  format written by SFEncoder, so it can be read back by SFStreamDecoder or
+//  SFParallelDecoder. The context keeps its block coder and block index
+//  between calls and the caller keeps the output vector, so once they have
+//  grown to the largest message seen, further calls do not allocate.
+//  reset() gives the retained memory back. Blocks are encoded on the calling
+//  thread; options.threads is ignored.
+class SFEncoderContext
+{
+    public:
+        SFEncoderContext(const SFOptions& options = SFOptions());
+
+        size_t compress(const uint8_t* data, size_t size, std::vector<uint8_t>& output);
+        size_t compress(const std::string& input, std::vector<uint8_t>& output);
+        void reset();
+        void reset(const SFOptions& options);
+        const SFOptions& get_options() const;
+
+    private:
+        SFOptions options;
+        SFBlockCoder coder;
+        SFAdaptiveTable selector;
+        ByteHistogram histogram;
+        std::vector<SFBlockInfo> index;
+};
+
+
+SFEncoderContext::SFEncoderContext(const SFOptions& options)
+{
+    reset(options);
+}
+
+//  Compresses the given bytes into output and returns the compressed size.
+//      data    -   bytes to compress
+//      size    -   number of bytes
+//      output  -   receives the compressed stream; its capacity is reused
+size_t SFEncoderContext::compress(const uint8_t* data, size_t size, std::vector<uint8_t>& output)
+{
+    output.clear();
+    SFBlockCoder::writeHeader(output, options);
+    selector.reset();
+    index.resize((size + options.blockSize - 1) / options.blockSize);
+    for (size_t i = 0; i < index.size(); i++) {
+        size_t offset = i * options.blockSize;
+        size_t length = size - offset < options.blockSize ? size - offset : options.blockSize;
+        index[i].offset = output.size();
+        index[i].rawSize = length;
+        if (options.adaptive) {
+            histogram.clear();
+            histogram.add(data + offset, length);
+            bool newTable = selector.update(histogram);
+            index[i].bitLength = coder.encode(data + offset, length, selector.get_table(), newTable, output);
+        } else {
+            index[i].bitLength = coder.encode(data + offset, length, output);
+        }
+    }
+    SFBlockCoder::writeEnd(output, index, output.size());
+    return output.size();
+}
+
+size_t SFEncoderContext::compress(const std::string& input, std::vector<uint8_t>& output)
+{
+    return compress(reinterpret_cast<const uint8_t*>(input.data()), input.size(), output);
+}
+
+//  Frees the buffers grown by earlier calls, keeping the options
+void SFEncoderContext::reset()
+{
+    reset(options);
+}
+
+//  Frees the buffers grown by earlier calls and switches to new options.
+//  Throws invalid_argument if the block size is out of range or the options
+//  cannot be combined.
+void SFEncoderContext::reset(const SFOptions& options)
+{
+    if (options.blockSize == 0 || options.blockSize > SFBlockCoder::MAX_BLOCK_SIZE) {
+        throw std::invalid_argument("Invalid block size");
+    }
+    SFBlockCoder::get_flags(options);
+    selector = SFAdaptiveTable(options);
+    this->options = options;
+    coder = SFBlockCoder(options);
+    index = std::vector<SFBlockInfo>();
+}
+
+const SFOptions& SFEncoderContext::get_options() const
+{
+    return options;
+}
+
+#endif
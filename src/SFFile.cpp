@@ -0,0 +1,87 @@
+#ifndef SFFile_H
+#define SFFile_H
+
+#include <MappedFile.cpp>
+#include <SFEncoder.cpp>
+#include <SFParallelDecoder.cpp>
+#include <SFSink.cpp>
+#include <SFStreamDecoder.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+//  Compresses the file at inputPath into a self-describing SFCoder stream at
+//  outputPath. The input is memory-mapped and encoded straight from the
+//  mapping, one batch of blocks at a time; pages of the input are discarded
+//  once their blocks are written, so neither the input nor the output is
+//  ever held in memory as a whole. Throws runtime_error if a file cannot be
+//  opened or written.
+//      inputPath   -   file to compress
+//      outputPath  -   file to create or overwrite
+//      options     -   block size and number of threads
+void compressFile(const std::string& inputPath, const std::string& outputPath,
+                  const SFOptions& options = SFOptions())
+{
+    MappedFile input(inputPath);
+    SFFileSink sink(outputPath);
+    SFEncoder encoder(sink, options);
+
+    //  one call to update() per batch lets every thread take part
+    size_t window = options.blockSize * (options.threads > 1 ? options.threads : 1) *
+                    SFEncoder::BATCH_PER_THREAD;
+    for (size_t offset = 0; offset < input.get_size(); offset += window) {
+        size_t length = input.get_size() - offset < window ? input.get_size() - offset : window;
+        encoder.update(input.get_data() + offset, length);
+        input.discard(offset, length);
+    }
+    encoder.finish();
+    sink.close();
+}
+
+//  Restores the file compressed by compressFile. The compressed file is
+//  memory-mapped and its block index read; the output file is created with
+//  the size the index gives, mapped, and the blocks are decoded straight
+//  into it on several threads, a batch at a time. Pages of both files are
+//  discarded once their batch is done, so the resident size stays around a
+//  few blocks per thread. A stream whose index cannot be read, such
+//  as one with trailing data, is decoded one block at a time instead,
+//  which reports what is wrong with it.
+//  Throws runtime_error if a file cannot be opened or written or the stream
+//  is invalid or corrupted.
+//      inputPath   -   compressed file
+//      outputPath  -   file to create or overwrite
+//      threads     -   number of decoding threads
+void decompressFile(const std::string& inputPath, const std::string& outputPath,
+                    unsigned threads = std::thread::hardware_concurrency())
+{
+    MappedFile input(inputPath);
+    SFParallelDecoder decoder(threads);
+    uint64_t size;
+    try {
+        size = decoder.get_size(input.get_data(), input.get_size());
+    } catch (const std::runtime_error&) {
+        SFFileSink sink(outputPath);
+        SFStreamDecoder streamDecoder;
+        if (streamDecoder.decode(input, sink) != input.get_size()) {
+            throw std::runtime_error("Trailing data after stream");
+        }
+        sink.close();
+        return;
+    }
+    if (size > SIZE_MAX) {
+        throw std::runtime_error("Stream is too large");
+    }
+    MappedOutputFile output(outputPath, size_t(size));
+    uint64_t inputDone = 0, outputDone = 0;
+    decoder.decode(input.get_data(), input.get_size(), output.get_data(), output.get_size(),
+                   [&](uint64_t inputOffset, uint64_t outputOffset) {
+        input.discard(inputDone, inputOffset - inputDone);
+        output.discard(outputDone, outputOffset - outputDone);
+        inputDone = inputOffset;
+        outputDone = outputOffset;
+    });
+    output.close();
+}
+
+#endif
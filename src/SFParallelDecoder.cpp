@@ -0,0 +1,150 @@
+#ifndef SFParallelDecoder_H
+#define SFParallelDecoder_H
+
+#include <SFBlock.cpp>
+#include <ThreadPool.cpp>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+//  Decodes a whole block stream written by SFEncoder on several threads.
+//  The block index at the end of the stream gives every block's position and
+//  uncompressed size, so the output is allocated once and each block is
+//  decoded straight into its final place, independently of the others.
+//  In adaptive streams a block may reuse the code table of an earlier block;
+//  the blocks carrying tables are found first, and a worker loads the table
+//  a block needs before decoding it.
+//  A caller streaming a large file through memory mappings can have the
+//  blocks decoded in batches of BATCH_PER_THREAD blocks per thread and be
+//  told after each batch how far the input and output are done.
+class SFParallelDecoder
+{
+    public:
+        static constexpr size_t BATCH_PER_THREAD = 4;
+
+        SFParallelDecoder(unsigned threads = std::thread::hardware_concurrency());
+
+        uint64_t get_size(const uint8_t* data, size_t size);
+        void decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity);
+        void decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity,
+                    const std::function<void(uint64_t, uint64_t)>& batchDone);
+        std::vector<uint8_t> decode(const uint8_t* data, size_t size);
+
+    private:
+        ThreadPool pool;
+        std::vector<SFBlockCoder> coders;
+        std::vector<SFBlockInfo> index;
+        std::vector<uint64_t> tableOffsets;
+        std::vector<uint64_t> loadedTables;
+
+        void findTables(const uint8_t* data, size_t size);
+};
+
+
+SFParallelDecoder::SFParallelDecoder(unsigned threads) : pool(threads)
+{
+    coders.resize(pool.get_size());
+}
+
+//  Returns the uncompressed size of the stream, read from its block index
+uint64_t SFParallelDecoder::get_size(const uint8_t* data, size_t size)
+{
+    return SFBlockCoder::readIndex(data, size, index);
+}
+
+//  Decodes the stream into output. Throws runtime_error if the stream is
+//  invalid or its uncompressed size exceeds capacity.
+//      data        -   encoded stream
+//      size        -   size of the stream in bytes
+//      output      -   destination of the uncompressed bytes
+//      capacity    -   size of output
+void SFParallelDecoder::decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity)
+{
+    decode(data, size, output, capacity, nullptr);
+}
+
+//  Decodes the stream into output like decode(data, size, output, capacity)
+//  in batches of blocks, calling batchDone(inputOffset, outputOffset) after
+//  each one: the blocks before inputOffset in the stream are decoded, as
+//  are the bytes before outputOffset in output.
+void SFParallelDecoder::decode(const uint8_t* data, size_t size, uint8_t* output, size_t capacity,
+                               const std::function<void(uint64_t, uint64_t)>& batchDone)
+{
+    if (get_size(data, size) > capacity) {
+        throw std::runtime_error("Output buffer is too small");
+    }
+    std::vector<uint64_t> outputOffsets(index.size());
+    uint64_t offset = 0;
+    for (size_t i = 0; i < index.size(); i++) {
+        outputOffsets[i] = offset;
+        offset += index[i].rawSize;
+    }
+
+    size_t blockSize;
+    uint8_t flags = SFBlockCoder::readHeader(data, size, blockSize);
+    bool adaptive = (flags & SFBlockCoder::FLAG_ADAPTIVE) != 0;
+    if (adaptive) {
+        findTables(data, size);
+    }
+    for (SFBlockCoder& coder : coders) {
+        coder.set_header(flags, blockSize);
+    }
+    loadedTables.assign(coders.size(), UINT64_MAX);
+
+    auto decodeBlock = [&](size_t i, unsigned worker) {
+        const SFBlockInfo& block = index[i];
+        if (getLE(data + block.offset, 4) != block.rawSize) {
+            throw std::runtime_error("Block does not match the index");
+        }
+        if (adaptive) {
+            uint64_t tableOffset = tableOffsets[i];
+            if (tableOffset != block.offset && loadedTables[worker] != tableOffset) {
+                coders[worker].loadTable(data + tableOffset, size - tableOffset);
+            }
+            loadedTables[worker] = tableOffset;
+        }
+        coders[worker].decode(data + block.offset, size - block.offset,
+                              output + outputOffsets[i], block.rawSize);
+    };
+    size_t batch = batchDone ? size_t(pool.get_size()) * BATCH_PER_THREAD : index.size();
+    for (size_t first = 0; first < index.size(); first += batch) {
+        size_t count = index.size() - first < batch ? index.size() - first : batch;
+        pool.run(count, [&](size_t i, unsigned worker) { decodeBlock(first + i, worker); });
+        if (batchDone) {
+            size_t next = first + count;
+            batchDone(next < index.size() ? index[next].offset : size,
+                      next < index.size() ? outputOffsets[next] : offset);
+        }
+    }
+}
+
+//  Finds for every block of an adaptive stream the offset of the block whose
+//  code table it is decoded with
+void SFParallelDecoder::findTables(const uint8_t* data, size_t size)
+{
+    tableOffsets.resize(index.size());
+    bool found = false;
+    uint64_t tableOffset = 0;
+    for (size_t i = 0; i < index.size(); i++) {
+        if (size - index[i].offset < 9) {
+            throw std::runtime_error("Truncated block");
+        }
+        if (data[index[i].offset + 8] != 0) {
+            tableOffset = index[i].offset;
+            found = true;
+        } else if (!found) {
+            throw std::runtime_error("Missing code table");
+        }
+        tableOffsets[i] = tableOffset;
+    }
+}
+
+std::vector<uint8_t> SFParallelDecoder::decode(const uint8_t* data, size_t size)
+{
+    std::vector<uint8_t> output(get_size(data, size));
+    decode(data, size, output.data(), output.size());
+    return output;
+}
+
+#endif
@@ -0,0 +1,106 @@
+#ifndef SFSink_H
+#define SFSink_H
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+//  Destination of encoded or decoded bytes
+class SFSink
+{
+    public:
+        virtual ~SFSink() {}
+        virtual void write(const uint8_t* data, size_t size) = 0;
+};
+
+//  Appends everything written to a caller-owned vector
+class SFVectorSink : public SFSink
+{
+    public:
+        SFVectorSink(std::vector<uint8_t>& output) : output(output) {}
+
+        void write(const uint8_t* data, size_t size) override
+        {
+            output.insert(output.end(), data, data + size);
+        }
+
+    private:
+        std::vector<uint8_t>& output;
+};
+
+//  Writes everything to a caller-owned output stream
+class SFStreamSink : public SFSink
+{
+    public:
+        SFStreamSink(std::ostream& output) : output(output) {}
+
+        void write(const uint8_t* data, size_t size) override
+        {
+            output.write(reinterpret_cast<const char*>(data), size);
+        }
+
+    private:
+        std::ostream& output;
+};
+
+//  Writes everything to a file it creates, through a stdio buffer of
+//  BUFFER_SIZE bytes. Writes larger than the buffer, such as whole encoded
+//  blocks, go to the file directly. close() reports errors the last writes
+//  may have deferred; the destructor closes silently.
+class SFFileSink : public SFSink
+{
+    public:
+        static constexpr size_t BUFFER_SIZE = size_t(1) << 16;
+
+        SFFileSink(const std::string& path) : path(path)
+        {
+            file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr) {
+                throw std::runtime_error("Cannot create " + path);
+            }
+            std::setvbuf(file, nullptr, _IOFBF, BUFFER_SIZE);
+        }
+
+        ~SFFileSink() override
+        {
+            if (file != nullptr) std::fclose(file);
+        }
+
+        SFFileSink(const SFFileSink&) = delete;
+        SFFileSink& operator=(const SFFileSink&) = delete;
+
+        void write(const uint8_t* data, size_t size) override
+        {
+            if (file == nullptr) {
+                throw std::logic_error("Sink is closed");
+            }
+            if (size != 0 && std::fwrite(data, 1, size, file) != size) {
+                throw std::runtime_error("Cannot write " + path);
+            }
+        }
+
+        //  Flushes and closes the file. Throws runtime_error if any write
+        //  failed.
+        void close()
+        {
+            if (file == nullptr) {
+                return;
+            }
+            bool failed = std::ferror(file) != 0;
+            failed = std::fclose(file) != 0 || failed;
+            file = nullptr;
+            if (failed) {
+                throw std::runtime_error("Cannot write " + path);
+            }
+        }
+
+    private:
+        std::FILE* file;
+        std::string path;
+};
+
+#endif
@@ -0,0 +1,72 @@
+#ifndef SFStreamDecoder_H
+#define SFStreamDecoder_H
+
+#include <MappedFile.cpp>
+#include <SFBlock.cpp>
+#include <SFSink.cpp>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+//  Decodes the block stream written by SFEncoder one block at a time, so only
+//  a single uncompressed block is held in memory
+class SFStreamDecoder
+{
+    public:
+        SFStreamDecoder();
+
+        size_t decode(const uint8_t* data, size_t size, SFSink& sink);
+        size_t decode(MappedFile& input, SFSink& sink);
+
+    private:
+        SFBlockCoder coder;
+        std::vector<uint8_t> block;
+
+        size_t decodeBlocks(const uint8_t* data, size_t size, SFSink& sink, MappedFile* input);
+};
+
+
+SFStreamDecoder::SFStreamDecoder()
+{
+}
+
+//  Decodes blocks until the end marker, writing the uncompressed bytes to
+//  sink, and returns the number of encoded bytes read including the index.
+//  Throws runtime_error if the stream is truncated.
+//      data    -   encoded stream
+//      size    -   number of bytes available
+//      sink    -   destination of the uncompressed bytes
+size_t SFStreamDecoder::decode(const uint8_t* data, size_t size, SFSink& sink)
+{
+    return decodeBlocks(data, size, sink, nullptr);
+}
+
+//  Decodes the stream in a mapped file like decode(data, size, sink),
+//  discarding the pages of every block once it is written, so the resident
+//  part of the mapping stays around one block.
+size_t SFStreamDecoder::decode(MappedFile& input, SFSink& sink)
+{
+    return decodeBlocks(input.get_data(), input.get_size(), sink, &input);
+}
+
+size_t SFStreamDecoder::decodeBlocks(const uint8_t* data, size_t size, SFSink& sink, MappedFile* input)
+{
+    size_t blockSize;
+    uint8_t flags = SFBlockCoder::readHeader(data, size, blockSize);
+    coder.set_header(flags, blockSize);
+    size_t position = SFBlockCoder::HEADER_SIZE;
+    while (true) {
+        block.clear();
+        size_t length = coder.decode(data + position, size - position, block);
+        if (length == 0) {
+            return position + SFBlockCoder::readEnd(data + position, size - position);
+        }
+        sink.write(block.data(), block.size());
+        if (input != nullptr) {
+            input->discard(position, length);
+        }
+        position += length;
+    }
+}
+
+#endif
@@ -0,0 +1,259 @@
+#ifndef SFTableBuilder_H
+#define SFTableBuilder_H
+
+#include <ByteHistogram.cpp>
+#include <SFCodeTable.cpp>
+#include <SymbolTraits.cpp>
+#include <cstdint>
+#include <stdexcept>
+
+//  Builds Shannon - Fano code tables from symbol frequencies.
+//  The builder keeps the frequency table sorted by the last build, so one
+//  instance can be reused for many tables. Symbols are ordered by frequency,
+//  descending, then by value, ascending, so equal inputs always produce
+//  equal codes. A build works on fixed-size member arrays and does not
+//  allocate; for 16-bit symbols they are allocated with the builder.
+//  Codes are kept within maxLength bits by moving a split towards the middle
+//  of its range whenever one half would hold more symbols than the bits left
+//  can address.
+template <typename Symbol>
+class SFBasicTableBuilder
+{
+    public:
+        static constexpr unsigned SYMBOL_BITS = SymbolTraits<Symbol>::BITS;
+        static constexpr size_t ALPHABET_SIZE = SymbolTraits<Symbol>::ALPHABET_SIZE;
+        static constexpr unsigned MIN_MAX_LENGTH = SYMBOL_BITS;
+
+        SFBasicTableBuilder(unsigned maxLength = SFBasicCodeTable<Symbol>::MAX_LENGTH);
+
+        void build(const SymbolHistogram<Symbol>& histogram, SFBasicCodeTable<Symbol>& table);
+        size_t get_alphabetSize() const;
+        Symbol get_symbol(size_t index) const;
+        uint64_t get_frequency(size_t index) const;
+        void set_maxLength(unsigned maxLength);
+        unsigned get_maxLength() const;
+
+    private:
+        struct Range
+        {
+            int begin;
+            int end;
+            uint64_t code;
+            unsigned length;
+        };
+
+        SymbolArray<Symbol, ALPHABET_SIZE> chars;
+        SymbolArray<uint64_t, ALPHABET_SIZE> frequency;
+        SymbolArray<uint64_t, ALPHABET_SIZE + 1> prefix;
+        SymbolArray<uint64_t, ALPHABET_SIZE> codes;
+        SymbolArray<unsigned, ALPHABET_SIZE> lengths;
+        SymbolArray<uint64_t, ALPHABET_SIZE> keys;
+        SymbolArray<uint64_t, ALPHABET_SIZE> sorted;
+        Range stack[SFBasicCodeTable<Symbol>::MAX_LENGTH + 1];
+        size_t alphabetSize;
+        unsigned maxLength;
+
+        void sortFrequencies();
+        void createEncoding();
+        int findSplit(int begin, int end, unsigned length);
+        int findBalancedSplit(int begin, int end);
+};
+
+using SFTableBuilder = SFBasicTableBuilder<uint8_t>;
+
+
+template <typename Symbol>
+SFBasicTableBuilder<Symbol>::SFBasicTableBuilder(unsigned maxLength)
+{
+    alphabetSize = 0;
+    set_maxLength(maxLength);
+}
+
+//  Sets the longest code the builder may produce. Throws invalid_argument
+//  unless it is between MIN_MAX_LENGTH, enough for every symbol, and
+//  SFCodeTable::MAX_LENGTH.
+template <typename Symbol>
+void SFBasicTableBuilder<Symbol>::set_maxLength(unsigned maxLength)
+{
+    if (maxLength < MIN_MAX_LENGTH || maxLength > SFBasicCodeTable<Symbol>::MAX_LENGTH) {
+        throw std::invalid_argument("Invalid maximum code length");
+    }
+    this->maxLength = maxLength;
+}
+
+template <typename Symbol>
+unsigned SFBasicTableBuilder<Symbol>::get_maxLength() const
+{
+    return maxLength;
+}
+
+//  Replaces the contents of table with a Shannon - Fano code for the
+//  symbols counted in histogram
+template <typename Symbol>
+void SFBasicTableBuilder<Symbol>::build(const SymbolHistogram<Symbol>& histogram,
+                                        SFBasicCodeTable<Symbol>& table)
+{
+    alphabetSize = 0;
+    const uint64_t* counts = histogram.get_counts();
+    for (size_t symbol = 0; symbol < ALPHABET_SIZE; symbol++) {
+        if (counts[symbol] != 0) {
+            chars[alphabetSize] = static_cast<Symbol>(symbol);
+            frequency[alphabetSize] = histogram.get_count(symbol);
+            alphabetSize++;
+        }
+    }
+    sortFrequencies();
+    createEncoding();
+
+    table.clear();
+    for (size_t i = 0; i < alphabetSize; i++) {
+        table.set(chars[i], codes[i], lengths[i]);
+    }
+}
+
+//  Returns the number of symbols in the last built table
+template <typename Symbol>
+size_t SFBasicTableBuilder<Symbol>::get_alphabetSize() const
+{
+    return alphabetSize;
+}
+
+//  Returns the symbol at the given position of the sorted frequency table
+template <typename Symbol>
+Symbol SFBasicTableBuilder<Symbol>::get_symbol(size_t index) const
+{
+    return chars[index];
+}
+
+//  Returns the frequency at the given position of the sorted frequency table
+template <typename Symbol>
+uint64_t SFBasicTableBuilder<Symbol>::get_frequency(size_t index) const
+{
+    return frequency[index];
+}
+
+//  Assigns codes by splitting the sorted frequency table into two halves of
+//  nearly equal total frequency, the first half getting a 0 bit and the
+//  second a 1 bit, and repeating on each half until single symbols remain.
+//  Pending ranges are kept on an explicit stack and codes are built as
+//  integers.
+template <typename Symbol>
+void SFBasicTableBuilder<Symbol>::createEncoding()
+{
+    prefix[0] = 0;
+    for (size_t i = 0; i < alphabetSize; i++) {
+        prefix[i + 1] = prefix[i] + frequency[i];
+    }
+    if (alphabetSize == 0) {
+        return;
+    }
+
+    size_t top = 0;
+    stack[top++] = Range{0, int(alphabetSize) - 1, 0, 0};
+    while (top > 0) {
+        Range range = stack[--top];
+        if (range.begin == range.end) {
+            codes[range.begin] = range.code;
+            lengths[range.begin] = range.length;
+            continue;
+        }
+        int split = findSplit(range.begin, range.end, range.length);
+        stack[top++] = Range{split, range.end, (range.code << 1) | 1, range.length + 1};
+        stack[top++] = Range{range.begin, split - 1, range.code << 1, range.length + 1};
+    }
+}
+
+//  Returns the first index of the second half of [begin, end]: the
+//  balanced split, clamped so that each half has at most
+//  2^(maxLength - length - 1) symbols. A range never holds more than
+//  2^(maxLength - length) symbols, so the clamp always leaves a valid split.
+//      begin   -   first index of the range
+//      end     -   last index of the range
+//      length  -   code length of the symbols of the range so far
+template <typename Symbol>
+int SFBasicTableBuilder<Symbol>::findSplit(int begin, int end, unsigned length)
+{
+    int split = findBalancedSplit(begin, end);
+    unsigned bitsLeft = maxLength - length - 1;
+    if (bitsLeft < SYMBOL_BITS) {
+        int halfCapacity = 1 << bitsLeft;
+        if (split > begin + halfCapacity) split = begin + halfCapacity;
+        if (split < end + 1 - halfCapacity) split = end + 1 - halfCapacity;
+    }
+    return split;
+}
+
+//  Returns the split of [begin, end] that makes the totals of the halves
+//  closest, the later one on a tie. The first candidate at which the first
+//  half reaches half the total is found by binary search on the prefix sums.
+template <typename Symbol>
+int SFBasicTableBuilder<Symbol>::findBalancedSplit(int begin, int end)
+{
+    uint64_t base = prefix[begin];
+    uint64_t total = prefix[end + 1] - base;
+
+    int low = begin + 1, high = end;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (2 * (prefix[middle] - base) >= total) {
+            high = middle;
+        } else {
+            low = middle + 1;
+        }
+    }
+
+    //  low is the first split with 2 * left >= total, or end if there is none
+    if (low > begin + 1) {
+        uint64_t before = total - 2 * (prefix[low - 1] - base);
+        uint64_t after = 2 * (prefix[low] - base);
+        after = after >= total ? after - total : total - after;
+        if (before < after) {
+            return low - 1;
+        }
+    }
+    return low;
+}
+
+//  Sorts the frequency table by frequency, descending, then by symbol,
+//  ascending. Every entry is packed into one key,
+//  (~frequency << SYMBOL_BITS) | symbol, whose ascending order is the wanted
+//  one, and the keys are sorted by an LSD radix sort on bytes, skipping the
+//  bytes all keys share. Frequencies must stay below 2^(64 - SYMBOL_BITS).
+template <typename Symbol>
+void SFBasicTableBuilder<Symbol>::sortFrequencies()
+{
+    for (size_t i = 0; i < alphabetSize; i++) {
+        keys[i] = (~frequency[i] << SYMBOL_BITS) | chars[i];
+    }
+
+    uint64_t* from = keys.data();
+    uint64_t* to = sorted.data();
+    for (unsigned shift = 0; shift < 64; shift += 8) {
+        size_t count[256] = {};
+        for (size_t i = 0; i < alphabetSize; i++) {
+            ++count[(from[i] >> shift) & 0xFF];
+        }
+        if (alphabetSize == 0 || count[(from[0] >> shift) & 0xFF] == alphabetSize) {
+            continue;
+        }
+        size_t position = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            size_t digitCount = count[digit];
+            count[digit] = position;
+            position += digitCount;
+        }
+        for (size_t i = 0; i < alphabetSize; i++) {
+            to[count[(from[i] >> shift) & 0xFF]++] = from[i];
+        }
+        uint64_t* swap = from;
+        from = to;
+        to = swap;
+    }
+
+    for (size_t i = 0; i < alphabetSize; i++) {
+        chars[i] = static_cast<Symbol>(from[i]);
+        frequency[i] = ~(from[i] >> SYMBOL_BITS) & ((uint64_t(1) << (64 - SYMBOL_BITS)) - 1);
+    }
+}
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef SymbolTraits_H
+#define SymbolTraits_H
+
+#include <cstdint>
+#include <cstddef>
+#include <algorithm>
+#include <memory>
+#include <type_traits>
+
+//  Alphabet of an unsigned symbol type: 8-bit symbols are bytes, 16-bit
+//  symbols cover alphabets of up to 65536 values, such as byte pairs or the
+//  ids of a token dictionary.
+template <typename Symbol>
+struct SymbolTraits
+{
+    static_assert(std::is_unsigned<Symbol>::value && sizeof(Symbol) <= 2,
+                  "Symbols are 8 or 16-bit unsigned integers");
+
+    static constexpr unsigned BITS = 8 * sizeof(Symbol);
+    static constexpr size_t ALPHABET_SIZE = size_t(1) << BITS;
+};
+
+//  Fixed-size array, typically with one element per symbol. Arrays of up to
+//  1024 elements, enough for the byte alphabet, are stored inline so byte
+//  coders keep their tables in the object; larger ones are allocated once,
+//  when the array is constructed, so objects holding them stay small.
+template <typename T, size_t Size, bool Inline = (Size <= 1024)>
+class SymbolArray
+{
+    public:
+        T& operator[](size_t index) { return values[index]; }
+        const T& operator[](size_t index) const { return values[index]; }
+        T* data() { return values; }
+        const T* data() const { return values; }
+
+    private:
+        T values[Size];
+};
+
+template <typename T, size_t Size>
+class SymbolArray<T, Size, false>
+{
+    public:
+        SymbolArray() : values(new T[Size]()) {}
+        SymbolArray(const SymbolArray& other) : values(new T[Size]) { *this = other; }
+        SymbolArray(SymbolArray&& other) = default;
+
+        SymbolArray& operator=(const SymbolArray& other)
+        {
+            if (!values) values.reset(new T[Size]);
+            std::copy(other.values.get(), other.values.get() + Size, values.get());
+            return *this;
+        }
+        SymbolArray& operator=(SymbolArray&& other) = default;
+
+        T& operator[](size_t index) { return values[index]; }
+        const T& operator[](size_t index) const { return values[index]; }
+        T* data() { return values.get(); }
+        const T* data() const { return values.get(); }
+
+    private:
+        std::unique_ptr<T[]> values;
+};
+
+#endif
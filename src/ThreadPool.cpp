@@ -0,0 +1,135 @@
+#ifndef ThreadPool_H
+#define ThreadPool_H
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//  Fixed set of worker threads running indexed jobs.
+//  run(count, job) calls job(index, worker) for every index below count,
+//  handing indices out one at a time, and returns once all of them are done.
+//  The calling thread takes part as worker 0, so a pool of one thread runs
+//  everything inline.
+class ThreadPool
+{
+    public:
+        ThreadPool(unsigned threads = std::thread::hardware_concurrency());
+        ~ThreadPool();
+
+        void run(size_t count, const std::function<void(size_t, unsigned)>& job);
+        unsigned get_size() const;
+
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        const std::function<void(size_t, unsigned)>* job;
+        size_t count;
+        std::atomic<size_t> next;
+        unsigned busy;
+        unsigned generation;
+        bool stopping;
+        std::exception_ptr error;
+
+        void work(unsigned worker);
+        void workLoop(unsigned worker);
+};
+
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    job = nullptr;
+    count = 0;
+    next = 0;
+    busy = 0;
+    generation = 0;
+    stopping = false;
+    for (unsigned i = 1; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+//  Runs job for every index in [0, count) and waits for all of them. The
+//  first exception thrown by a job is rethrown here.
+//      count   -   number of jobs
+//      job     -   callable taking the job index and the worker number
+void ThreadPool::run(size_t count, const std::function<void(size_t, unsigned)>& job)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->job = &job;
+        this->count = count;
+        next = 0;
+        busy = workers.size();
+        error = nullptr;
+        ++generation;
+    }
+    wake.notify_all();
+    work(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this]() { return busy == 0; });
+    this->job = nullptr;
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+//  Returns the number of threads, including the caller of run()
+unsigned ThreadPool::get_size() const
+{
+    return workers.size() + 1;
+}
+
+void ThreadPool::work(unsigned worker)
+{
+    size_t index;
+    while ((index = next++) < count) {
+        try {
+            (*job)(index, worker);
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!error) error = std::current_exception();
+            next = count;
+        }
+    }
+}
+
+void ThreadPool::workLoop(unsigned worker)
+{
+    unsigned seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [this, seen]() { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        work(worker);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --busy;
+        }
+        done.notify_one();
+    }
+}
+
+#endif
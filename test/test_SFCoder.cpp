@@ -1,5 +1,51 @@
 #include <gtest/gtest.h>
 #include <SFCoder.cpp>
+#include <SFEncoder.cpp>
+#include <SFStreamDecoder.cpp>
+#include <SFParallelDecoder.cpp>
+#include <SFFile.cpp>
+#include <SFEncoderContext.cpp>
+#include <SFDictionary.cpp>
+#include <MyMap.cpp>
+#include <BTreeMap.cpp>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <new>
+#include <random>
+
+//  Number of calls to the global operator new, for the allocation tests.
+//  The replacements are kept out of line so that GCC does not pair the
+//  inlined malloc and free with new and delete expressions.
+static std::atomic<size_t> allocationCount(0);
+
+#if defined(__GNUC__)
+#define TEST_NOINLINE __attribute__((noinline))
+#else
+#define TEST_NOINLINE
+#endif
+
+TEST_NOINLINE void* operator new(size_t size)
+{
+    ++allocationCount;
+    void* pointer = std::malloc(size ? size : 1);
+    if (pointer == nullptr) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+TEST_NOINLINE void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+TEST_NOINLINE void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
 
 TEST(SFCoder, oneLetter)
 {
@@ -31,8 +77,882 @@ TEST(SFCoder, smallPhrase)
     SFCoder mycoder(text);
 
     EXPECT_EQ(mycoder.compression_ratio(), (38 * 1.f/96));
-    EXPECT_EQ(mycoder.get_encoded(), "10011110010010100010000100011001101101");
+    EXPECT_EQ(mycoder.get_encoded(), "10011000010100000111010000011011100111");
     EXPECT_EQ(mycoder.get_decoded(), text);
     EXPECT_EQ(mycoder.get_orsize(), 96);
     EXPECT_EQ(mycoder.get_ensize(), 38);
-}
\ No newline at end of file
+}
+
+TEST(SFCoder, packedPayload)
+{
+    std::string text = "abbb";
+    SFCoder mycoder(text);
+
+    EXPECT_EQ(mycoder.get_encoded(), "1000");
+    EXPECT_EQ(mycoder.get_bitlength(), 4);
+    EXPECT_EQ(mycoder.get_payload(), std::vector<uint8_t>({0x80}));
+    EXPECT_EQ(mycoder.get_decoded(), text);
+}
+
+TEST(SFCoder, deterministicTies)
+{
+    // every symbol has the same frequency, so only the tie order decides codes
+    std::string text;
+    for (int i = 0; i < 256; i++) text += static_cast<char>(255 - i);
+    SFCoder first(text);
+    SFCoder second(text);
+
+    EXPECT_EQ(first.get_payload(), second.get_payload());
+    for (int i = 0; i < 256; i++) {
+        EXPECT_EQ(first.get_table().get_length(i), 8);
+        EXPECT_EQ(first.get_table().get_code(i), i);
+    }
+}
+
+TEST(BitStream, roundTrip)
+{
+    BitWriter writer;
+    writer.write(0x5, 3);
+    writer.write(0x123456789ABCDEFull, 60);
+    writer.write(0x1, 1);
+    writer.finish();
+
+    EXPECT_EQ(writer.get_bitlength(), 64);
+    EXPECT_EQ(writer.get_bytes().size(), 8);
+
+    BitReader reader(writer.get_bytes().data(), writer.get_bytes().size());
+    EXPECT_EQ(reader.read(3), 0x5);
+    EXPECT_EQ(reader.read(60), 0x123456789ABCDEFull);
+    EXPECT_EQ(reader.read(1), 0x1);
+    EXPECT_EQ(reader.read(8), 0);
+}
+
+TEST(SFDecoder, longCodes)
+{
+    // Fibonacci-like frequencies produce codes longer than the root table
+    std::string text;
+    int a = 1, b = 1;
+    for (char c = 'a'; c <= 'p'; c++) {
+        text += std::string(a, c);
+        int next = a + b;
+        a = b;
+        b = next;
+    }
+    SFCoder mycoder(text);
+    SFDecoder decoder(mycoder.get_table());
+
+    EXPECT_GT(mycoder.get_table().get_maxLength(), SFDecoder::ROOT_BITS);
+    EXPECT_EQ(decoder.decode(mycoder.get_payload(), text.size()), text);
+
+    //  the same codes split into three interleaved streams
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+    BitWriter writers[3];
+    mycoder.get_table().encode(data, text.size(), writers, 3);
+    std::vector<uint8_t> streams;
+    size_t offsets[4] = {0};
+    for (unsigned s = 0; s < 3; s++) {
+        writers[s].finish();
+        streams.insert(streams.end(), writers[s].get_bytes().begin(), writers[s].get_bytes().end());
+        offsets[s + 1] = streams.size();
+    }
+    std::string decoded(text.size(), '\0');
+    decoder.decode(streams.data(), offsets, 3, reinterpret_cast<uint8_t*>(&decoded[0]), text.size());
+    EXPECT_EQ(decoded, text);
+}
+
+TEST(ByteHistogram, counts)
+{
+    std::string text(ByteHistogram::PARALLEL_MIN_SIZE + 5, 'a');
+    for (size_t i = 0; i < text.size(); i += 3) text[i] = 'b';
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    ByteHistogram serial(data, text.size());
+    ByteHistogram parallel(data, text.size(), 4);
+
+    EXPECT_EQ(serial.get_total(), text.size());
+    EXPECT_EQ(serial.get_alphabetSize(), 2);
+    EXPECT_EQ(serial.get_count('b'), (text.size() + 2) / 3);
+    EXPECT_EQ(serial.get_count('a'), text.size() - serial.get_count('b'));
+    for (int i = 0; i < 256; i++) {
+        EXPECT_EQ(parallel.get_count(i), serial.get_count(i));
+    }
+}
+
+TEST(SFEncoder, streamRoundTrip)
+{
+    std::string text;
+    for (int i = 0; i < 1000; i++) text += "line " + std::to_string(i * i) + "\n";
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> encoded;
+    SFVectorSink encodedSink(encoded);
+    SFOptions options;
+    options.blockSize = 1000;
+    SFEncoder encoder(encodedSink, options);
+    for (size_t i = 0; i < text.size(); i += 777) {
+        encoder.update(data + i, std::min<size_t>(777, text.size() - i));
+    }
+    encoder.finish();
+
+    std::vector<uint8_t> decoded;
+    SFVectorSink decodedSink(decoded);
+    SFStreamDecoder decoder;
+    EXPECT_EQ(decoder.decode(encoded.data(), encoded.size(), decodedSink), encoded.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+    EXPECT_LT(encoded.size(), text.size());
+}
+
+TEST(SFEncoder, emptyStream)
+{
+    std::vector<uint8_t> encoded, decoded;
+    SFVectorSink encodedSink(encoded), decodedSink(decoded);
+    SFEncoder encoder(encodedSink);
+    encoder.finish();
+
+    SFStreamDecoder decoder;
+    EXPECT_EQ(decoder.decode(encoded.data(), encoded.size(), decodedSink), encoded.size());
+    EXPECT_TRUE(decoded.empty());
+    EXPECT_TRUE(SFParallelDecoder(2).decode(encoded.data(), encoded.size()).empty());
+    EXPECT_THROW(decoder.decode(encoded.data(), 2, decodedSink), std::runtime_error);
+}
+
+TEST(SFEncoder, parallelMatchesSerial)
+{
+    std::string text;
+    for (int i = 0; i < 20000; i++) text += (i % 1000 < 500) ? "abcabd" : "xyz\n";
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> serial, parallel, decoded;
+    SFVectorSink serialSink(serial), parallelSink(parallel), decodedSink(decoded);
+    SFOptions options;
+    options.blockSize = 4096;
+    SFEncoder serialEncoder(serialSink, options);
+    serialEncoder.update(data, text.size());
+    serialEncoder.finish();
+
+    options.threads = 4;
+    SFEncoder parallelEncoder(parallelSink, options);
+    parallelEncoder.update(data, 1000);
+    parallelEncoder.update(data + 1000, text.size() - 1000);
+    parallelEncoder.finish();
+
+    EXPECT_EQ(parallel, serial);
+    SFStreamDecoder decoder;
+    decoder.decode(parallel.data(), parallel.size(), decodedSink);
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+
+    SFParallelDecoder parallelDecoder(4);
+    EXPECT_EQ(parallelDecoder.get_size(parallel.data(), parallel.size()), text.size());
+    decoded = parallelDecoder.decode(parallel.data(), parallel.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+}
+
+TEST(SFEncoder, corruptBlockSize)
+{
+    std::string text;
+    for (int i = 0; i < 2000; i++) text += "hello " + std::to_string(i) + "\n";
+    std::vector<uint8_t> encoded, decoded;
+    SFVectorSink encodedSink(encoded), decodedSink(decoded);
+    SFOptions options;
+    options.blockSize = 4096;
+    SFEncoder encoder(encodedSink, options);
+    encoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    encoder.finish();
+
+    //  a huge size in the first block is rejected before any output grows
+    std::vector<uint8_t> corrupt = encoded;
+    corrupt[SFBlockCoder::HEADER_SIZE] = 0xF0;
+    std::fill(corrupt.begin() + SFBlockCoder::HEADER_SIZE + 1, corrupt.begin() + SFBlockCoder::HEADER_SIZE + 4,
+              0xFF);
+    EXPECT_THROW(SFStreamDecoder().decode(corrupt.data(), corrupt.size(), decodedSink), std::runtime_error);
+    EXPECT_THROW(SFParallelDecoder(2).decode(corrupt.data(), corrupt.size()), std::runtime_error);
+    std::vector<uint8_t> block = {1, 2, 3};
+    EXPECT_THROW(SFBlockCoder().decode(corrupt.data() + SFBlockCoder::HEADER_SIZE,
+                                       corrupt.size() - SFBlockCoder::HEADER_SIZE, block),
+                 std::runtime_error);
+    EXPECT_EQ(block.size(), 3u);
+
+    //  and so is an index claiming as much, even if its total agrees
+    size_t indexOffset = getLE(corrupt.data() + corrupt.size() - 8, 8);
+    std::copy(corrupt.begin() + SFBlockCoder::HEADER_SIZE, corrupt.begin() + SFBlockCoder::HEADER_SIZE + 4,
+              corrupt.begin() + indexOffset + 8 + 16);
+    uint64_t total = text.size() - getLE(encoded.data() + SFBlockCoder::HEADER_SIZE, 4) + 0xFFFFFFF0u;
+    for (int i = 0; i < 8; i++) corrupt[corrupt.size() - 16 + i] = uint8_t(total >> (8 * i));
+    EXPECT_THROW(SFParallelDecoder(2).get_size(corrupt.data(), corrupt.size()), std::runtime_error);
+
+    //  context blocks may code bytes in no bits, but not beyond the block size
+    options.contextModel = true;
+    std::vector<uint8_t> context;
+    SFVectorSink contextSink(context);
+    SFEncoder contextEncoder(contextSink, options);
+    contextEncoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    contextEncoder.finish();
+    indexOffset = getLE(context.data() + context.size() - 8, 8);
+    uint64_t firstSize = getLE(context.data() + indexOffset + 8 + 16, 4);
+    context[indexOffset + 8 + 16 + 2] = 0x10;
+    total = text.size() - firstSize + getLE(context.data() + indexOffset + 8 + 16, 4);
+    for (int i = 0; i < 8; i++) context[context.size() - 16 + i] = uint8_t(total >> (8 * i));
+    EXPECT_THROW(SFParallelDecoder(2).get_size(context.data(), context.size()), std::runtime_error);
+    EXPECT_THROW(SFParallelDecoder(2).decode(context.data(), context.size()), std::runtime_error);
+    options.contextModel = false;
+
+    //  blocks of a single byte value take no payload bits and stay valid
+    std::string same(100000, 'a');
+    std::vector<uint8_t> repeated;
+    SFVectorSink repeatedSink(repeated);
+    SFEncoder repeatedEncoder(repeatedSink, options);
+    repeatedEncoder.update(reinterpret_cast<const uint8_t*>(same.data()), same.size());
+    repeatedEncoder.finish();
+    decoded = SFParallelDecoder(2).decode(repeated.data(), repeated.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), same);
+}
+
+TEST(SFEncoder, adaptiveTables)
+{
+    std::string text;
+    for (int i = 0; i < 6000; i++) text += "log entry " + std::to_string(i % 97) + " ok\n";
+    for (int i = 0; i < 3000; i++) text += "QWERTY-" + std::to_string(i * 7 % 13) + ";";
+    for (int i = 0; i < 6000; i++) text += "log entry " + std::to_string(i % 89) + " ok\n";
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> fixed, serial, parallel, context;
+    SFVectorSink fixedSink(fixed), serialSink(serial), parallelSink(parallel);
+    SFOptions options;
+    options.blockSize = 2048;
+    SFEncoder fixedEncoder(fixedSink, options);
+    fixedEncoder.update(data, text.size());
+    fixedEncoder.finish();
+
+    options.adaptive = true;
+    SFEncoder serialEncoder(serialSink, options);
+    serialEncoder.update(data, text.size());
+    serialEncoder.finish();
+    options.threads = 3;
+    SFEncoder parallelEncoder(parallelSink, options);
+    parallelEncoder.update(data, text.size());
+    parallelEncoder.finish();
+    SFEncoderContext(options).compress(text, context);
+
+    EXPECT_EQ(parallel, serial);
+    EXPECT_EQ(context, serial);
+    EXPECT_LT(serial.size(), fixed.size());
+
+    std::vector<SFBlockInfo> index;
+    SFBlockCoder::readIndex(serial.data(), serial.size(), index);
+    size_t tables = 0;
+    for (const SFBlockInfo& block : index) tables += serial[block.offset + 8];
+    EXPECT_GT(tables, 1u);
+    EXPECT_LT(tables, index.size() / 2);
+
+    std::vector<uint8_t> decoded;
+    SFVectorSink decodedSink(decoded);
+    SFStreamDecoder decoder;
+    EXPECT_EQ(decoder.decode(serial.data(), serial.size(), decodedSink), serial.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+    decoded = SFParallelDecoder(3).decode(serial.data(), serial.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+
+    serial[SFBlockCoder::HEADER_SIZE + 8] = 0;
+    EXPECT_THROW(SFParallelDecoder(2).decode(serial.data(), serial.size()), std::runtime_error);
+    serial[5] = 0x80;
+    EXPECT_THROW(decoder.decode(serial.data(), serial.size(), decodedSink), std::runtime_error);
+}
+
+TEST(SFEncoder, contextTables)
+{
+    std::string text;
+    for (int i = 0; i < 4000; i++) {
+        text += "2024-01-01 " + std::string(i % 3 ? "INFO" : "WARN") + " user=" + std::to_string(i * 31 % 500) +
+                " path=/api/v1/items status=200\n";
+    }
+    text += '\xFF';
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> fixed, serial, parallel, context;
+    SFVectorSink fixedSink(fixed), serialSink(serial), parallelSink(parallel);
+    SFOptions options;
+    options.blockSize = 65536;
+    SFEncoder fixedEncoder(fixedSink, options);
+    fixedEncoder.update(data, text.size());
+    fixedEncoder.finish();
+
+    options.contextModel = true;
+    SFEncoder serialEncoder(serialSink, options);
+    serialEncoder.update(data, text.size());
+    serialEncoder.finish();
+    options.threads = 3;
+    SFEncoder parallelEncoder(parallelSink, options);
+    parallelEncoder.update(data, text.size());
+    parallelEncoder.finish();
+    SFEncoderContext(options).compress(text, context);
+
+    EXPECT_EQ(parallel, serial);
+    EXPECT_EQ(context, serial);
+    EXPECT_LT(serial.size() * 10, fixed.size() * 8);
+
+    std::vector<uint8_t> decoded;
+    SFVectorSink decodedSink(decoded);
+    SFStreamDecoder decoder;
+    EXPECT_EQ(decoder.decode(serial.data(), serial.size(), decodedSink), serial.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+    decoded = SFParallelDecoder(3).decode(serial.data(), serial.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+
+    options.adaptive = true;
+    EXPECT_THROW(SFEncoderContext{options}, std::invalid_argument);
+    EXPECT_THROW(SFEncoder(parallelSink, options), std::invalid_argument);
+}
+
+TEST(SFEncoder, interleavedStreams)
+{
+    std::string text;
+    for (int i = 0; i < 30001; i++) {
+        text += char('a' + (i * i) % 23 % 13);
+    }
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(text.data());
+
+    std::vector<uint8_t> single, serial, parallel, adaptive;
+    SFVectorSink singleSink(single), serialSink(serial), parallelSink(parallel), adaptiveSink(adaptive);
+    SFOptions options;
+    options.blockSize = 4099;
+    SFEncoder singleEncoder(singleSink, options);
+    singleEncoder.update(data, text.size());
+    singleEncoder.finish();
+
+    options.streams = 4;
+    SFEncoder serialEncoder(serialSink, options);
+    serialEncoder.update(data, text.size());
+    serialEncoder.finish();
+    options.threads = 3;
+    SFEncoder parallelEncoder(parallelSink, options);
+    parallelEncoder.update(data, text.size());
+    parallelEncoder.finish();
+    options.adaptive = true;
+    SFEncoder adaptiveEncoder(adaptiveSink, options);
+    adaptiveEncoder.update(data, text.size());
+    adaptiveEncoder.finish();
+
+    EXPECT_EQ(parallel, serial);
+    EXPECT_EQ(serial[5], SFBlockCoder::FLAG_INTERLEAVED);
+    EXPECT_LT(serial.size(), single.size() + 8 * 20);
+    for (const std::vector<uint8_t>* stream : {&serial, &adaptive}) {
+        std::vector<uint8_t> decoded;
+        SFVectorSink decodedSink(decoded);
+        SFStreamDecoder decoder;
+        EXPECT_EQ(decoder.decode(stream->data(), stream->size(), decodedSink), stream->size());
+        EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+        decoded = SFParallelDecoder(3).decode(stream->data(), stream->size());
+        EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text);
+    }
+
+    //  a stream size running past the payload
+    std::vector<uint8_t> corrupted = serial;
+    size_t payload = SFBlockCoder::HEADER_SIZE + 8;
+    payload += SFCodeTable().read(corrupted.data() + payload, corrupted.size() - payload) + 8;
+    corrupted[payload + 3] = 0xFF;
+    EXPECT_THROW(SFParallelDecoder(1).decode(corrupted.data(), corrupted.size()), std::runtime_error);
+
+    options.streams = SFDecoder::MAX_STREAMS + 1;
+    EXPECT_THROW(SFEncoder(parallelSink, options), std::invalid_argument);
+    options.streams = 2;
+    options.adaptive = false;
+    options.contextModel = true;
+    EXPECT_THROW(SFEncoderContext{options}, std::invalid_argument);
+}
+
+TEST(SFFile, roundTripAndCorruption)
+{
+    std::string text;
+    for (int i = 0; i < 5000; i++) text += "2024-01-01 INFO request " + std::to_string(i) + " ok\n";
+    std::string original = testing::TempDir() + "sf_original.txt";
+    std::string compressed = testing::TempDir() + "sf_compressed.sfc";
+    std::string restored = testing::TempDir() + "sf_restored.txt";
+    std::ofstream(original, std::ios::binary) << text;
+
+    SFOptions options;
+    options.blockSize = 10000;
+    compressFile(original, compressed, options);
+    decompressFile(compressed, restored);
+
+    std::ifstream restoredFile(restored, std::ios::binary);
+    std::string result((std::istreambuf_iterator<char>(restoredFile)), std::istreambuf_iterator<char>());
+    EXPECT_EQ(result, text);
+
+    std::fstream corrupt(compressed, std::ios::binary | std::ios::in | std::ios::out);
+    corrupt.seekp(200);
+    corrupt.put('\x55');
+    corrupt.close();
+    EXPECT_THROW(decompressFile(compressed, restored), std::runtime_error);
+
+    std::remove(original.c_str());
+    std::remove(compressed.c_str());
+    std::remove(restored.c_str());
+}
+
+TEST(SFFile, mappedInput)
+{
+    std::string text;
+    for (int i = 0; i < 20000; i++) text += "mapped line " + std::to_string(i * 7919 % 1000) + "\n";
+    std::string original = testing::TempDir() + "sf_mapped.txt";
+    std::string compressed = testing::TempDir() + "sf_mapped.sfc";
+    std::string restored = testing::TempDir() + "sf_mapped_restored.txt";
+    std::ofstream(original, std::ios::binary) << text;
+
+    {
+        MappedFile mapped(original);
+        ASSERT_EQ(mapped.get_size(), text.size());
+        mapped.discard(0, text.size() / 2);
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(mapped.get_data()), mapped.get_size()), text);
+    }
+
+    SFOptions options;
+    options.blockSize = 4096;
+    options.threads = 3;
+    compressFile(original, compressed, options);
+    decompressFile(compressed, restored, 3);
+    {
+        MappedFile result(restored);
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(result.get_data()), result.get_size()), text);
+    }
+    std::ofstream(compressed, std::ios::binary | std::ios::app) << "tail";
+    EXPECT_THROW(decompressFile(compressed, restored), std::runtime_error);
+
+    {
+        MappedOutputFile output(restored, 5);
+        std::copy(text.begin(), text.begin() + 5, output.get_data());
+        output.close();
+    }
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(MappedFile(restored).get_data()), 5), text.substr(0, 5));
+
+    std::ofstream(original, std::ios::binary | std::ios::trunc);
+    compressFile(original, compressed);
+    decompressFile(compressed, restored);
+    EXPECT_EQ(MappedFile(restored).get_size(), 0u);
+    EXPECT_THROW(MappedFile(testing::TempDir() + "sf_missing.txt"), std::runtime_error);
+
+    std::remove(original.c_str());
+    std::remove(compressed.c_str());
+    std::remove(restored.c_str());
+}
+
+TEST(SFCodeTable, canonical)
+{
+    std::string text = "this is a canonical code table test";
+    SFCoder mycoder(text);
+    SFCodeTable table = mycoder.get_table();
+    table.canonicalize();
+
+    std::vector<uint8_t> original, canonical;
+    mycoder.get_table().write(original);
+    table.write(canonical);
+    EXPECT_LT(canonical.size(), original.size());
+
+    SFCodeTable restored;
+    EXPECT_EQ(restored.read(canonical.data(), canonical.size()), canonical.size());
+    EXPECT_TRUE(restored.is_canonical());
+    for (int i = 0; i < 256; i++) {
+        EXPECT_EQ(restored.has(i), mycoder.get_table().has(i));
+        EXPECT_EQ(restored.get_length(i), mycoder.get_table().get_length(i));
+        EXPECT_EQ(restored.get_code(i), table.get_code(i));
+    }
+
+    // codes grow with length, then with symbol
+    int previous = -1;
+    for (unsigned length = 1; length <= table.get_maxLength(); length++) {
+        for (int i = 0; i < 256; i++) {
+            if (!table.has(i) || table.get_length(i) != length) continue;
+            if (previous < 0) {
+                EXPECT_EQ(table.get_code(i), 0);
+            } else {
+                unsigned shift = length - table.get_length(previous);
+                EXPECT_EQ(table.get_code(i), (table.get_code(previous) + 1) << shift);
+            }
+            previous = i;
+        }
+    }
+
+    BitWriter writer;
+    table.encode(reinterpret_cast<const uint8_t*>(text.data()), text.size(), writer);
+    writer.finish();
+    EXPECT_EQ(SFDecoder(restored).decode(writer.get_bytes(), text.size()), text);
+
+    std::vector<uint8_t> stream, plainStream;
+    SFVectorSink sink(stream), plainSink(plainStream);
+    SFOptions options;
+    options.canonical = true;
+    SFEncoder encoder(sink, options), plainEncoder(plainSink);
+    for (int i = 0; i < 3; i++) {
+        encoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+        plainEncoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    }
+    encoder.finish();
+    plainEncoder.finish();
+    EXPECT_LT(stream.size(), plainStream.size());
+    std::vector<uint8_t> decoded = SFParallelDecoder(1).decode(stream.data(), stream.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), text + text + text);
+}
+
+TEST(SFTableBuilder, maxLength)
+{
+    std::vector<uint8_t> data;
+    uint64_t a = 1, b = 1;
+    for (int symbol = 0; symbol < 30; symbol++) {
+        data.insert(data.end(), a, static_cast<uint8_t>(symbol));
+        uint64_t next = a + b;
+        a = b;
+        b = next;
+    }
+    ByteHistogram histogram(data.data(), data.size());
+    SFCodeTable unlimited, limited;
+    SFTableBuilder(SFCodeTable::MAX_LENGTH).build(histogram, unlimited);
+    SFTableBuilder(12).build(histogram, limited);
+
+    EXPECT_GT(unlimited.get_maxLength(), 12);
+    EXPECT_EQ(limited.get_maxLength(), 12);
+    EXPECT_THROW(SFTableBuilder(7), std::invalid_argument);
+
+    BitWriter writer;
+    limited.encode(data.data(), data.size(), writer);
+    writer.finish();
+    std::vector<uint8_t> decoded(data.size());
+    SFDecoder(limited).decode(writer.get_bytes().data(), writer.get_bytes().size(), decoded.data(), decoded.size());
+    EXPECT_EQ(decoded, data);
+}
+
+TEST(SFCoder16, digrams)
+{
+    std::string text;
+    for (int i = 0; i < 2000; i++) text += "the quick brown fox " + std::to_string(i % 37) + " jumps; ";
+    SFCoder16::String pairs;
+    for (size_t i = 0; i + 1 < text.size(); i += 2) {
+        pairs.push_back(static_cast<uint16_t>(uint8_t(text[i]) << 8 | uint8_t(text[i + 1])));
+    }
+    pairs.push_back(0xFFFF);
+    pairs.push_back(0x0100);
+
+    SFCoder bytes(text);
+    SFCoder16 digrams(pairs);
+    EXPECT_EQ(digrams.get_decoded(), pairs);
+    EXPECT_EQ(digrams.get_orsize(), int(pairs.size() * 16));
+    EXPECT_LT(digrams.get_ensize(), bytes.get_ensize());
+
+    SFBasicCodeTable<uint16_t> table = digrams.get_table(), restored;
+    for (int canonical = 0; canonical < 2; canonical++) {
+        if (canonical) table.canonicalize();
+        std::vector<uint8_t> serialized;
+        table.write(serialized);
+        EXPECT_EQ(restored.read(serialized.data(), serialized.size()), serialized.size());
+        for (uint16_t pair : pairs) {
+            EXPECT_EQ(restored.get_length(pair), table.get_length(pair));
+            EXPECT_EQ(restored.get_code(pair), table.get_code(pair));
+        }
+        EXPECT_EQ(restored.get_alphabetSize(), table.get_alphabetSize());
+    }
+
+    //  every 16-bit symbol present: codes must stay within the limit
+    SFCoder16::String all(65536);
+    for (size_t i = 0; i < all.size(); i++) all[i] = static_cast<uint16_t>(i);
+    all.insert(all.end(), 1000, 7);
+    SymbolHistogram<uint16_t> histogram(all.data(), all.size());
+    SFBasicTableBuilder<uint16_t> builder(16);
+    builder.build(histogram, table);
+    EXPECT_EQ(table.get_alphabetSize(), 65536u);
+    EXPECT_EQ(table.get_maxLength(), 16u);
+    EXPECT_EQ(table.get_length(7), 16u);
+    EXPECT_THROW(SFBasicTableBuilder<uint16_t>(15), std::invalid_argument);
+    BitWriter writer;
+    table.encode(all.data(), all.size(), writer);
+    writer.finish();
+    SFCoder16::String decoded(all.size());
+    SFBasicDecoder<uint16_t>(table).decode(writer.get_bytes().data(), writer.get_bytes().size(),
+                                           decoded.data(), decoded.size());
+    EXPECT_EQ(decoded, all);
+}
+
+TEST(SFEncoderContext, reuseWithoutAllocation)
+{
+    std::string text;
+    for (int i = 0; i < 3000; i++) text += "message " + std::to_string(i * 31 % 977) + " payload\n";
+    std::string small = text.substr(0, 5000);
+
+    SFOptions options;
+    options.blockSize = 8192;
+    SFEncoderContext context(options);
+    std::vector<uint8_t> output, expected;
+    SFVectorSink sink(expected);
+    SFEncoder encoder(sink, options);
+    encoder.update(reinterpret_cast<const uint8_t*>(text.data()), text.size());
+    encoder.finish();
+    EXPECT_EQ(context.compress(text, output), expected.size());
+    EXPECT_EQ(output, expected);
+
+    size_t before = allocationCount;
+    for (int i = 0; i < 10; i++) {
+        context.compress(i % 2 ? small : text, output);
+    }
+    context.compress(std::string(), output);
+    EXPECT_EQ(allocationCount - before, 0u);
+
+    std::vector<uint8_t> decoded;
+    SFVectorSink decodedSink(decoded);
+    context.compress(small, output);
+    EXPECT_EQ(SFStreamDecoder().decode(output.data(), output.size(), decodedSink), output.size());
+    EXPECT_EQ(std::string(decoded.begin(), decoded.end()), small);
+
+    context.reset();
+    context.compress(text, output);
+    EXPECT_EQ(output, expected);
+    EXPECT_THROW(context.reset(SFOptions{0}), std::invalid_argument);
+}
+
+TEST(SFDictionary, batchRoundTrip)
+{
+    std::vector<std::string> messages;
+    for (int i = 0; i < 500; i++) {
+        messages.push_back("{\"user\":" + std::to_string(i * 7919 % 10007) + ",\"event\":\"" +
+                           (i % 3 ? "click" : "view") + "\",\"page\":\"/items/" + std::to_string(i) + "\"}");
+    }
+    messages.push_back("");
+    messages.push_back("unseen bytes: \x01\x7f\xff");
+
+    std::vector<SFSpan> spans;
+    size_t rawTotal = 0;
+    for (const std::string& message : messages) {
+        spans.push_back({reinterpret_cast<const uint8_t*>(message.data()), message.size()});
+        rawTotal += message.size();
+    }
+    SFDictionary trained;
+    std::vector<uint8_t> serialized;
+    EXPECT_THROW(trained.write(serialized), std::logic_error);
+    trained.train(spans.data(), 100);
+    trained.write(serialized);
+    SFDictionary dictionary;
+    EXPECT_EQ(dictionary.read(serialized.data(), serialized.size()), serialized.size());
+
+    std::vector<uint8_t> encodedBytes, decodedBytes;
+    std::vector<SFSpan> encoded, decoded;
+    trained.encodeBatch(spans.data(), spans.size(), encodedBytes, encoded);
+    EXPECT_LT(encodedBytes.size(), rawTotal * 3 / 4);
+    dictionary.decodeBatch(encoded.data(), encoded.size(), decodedBytes, decoded);
+    ASSERT_EQ(decoded.size(), messages.size());
+    for (size_t i = 0; i < messages.size(); i++) {
+        EXPECT_EQ(std::string(reinterpret_cast<const char*>(decoded[i].data), decoded[i].size), messages[i]);
+    }
+
+    std::vector<uint8_t> single;
+    EXPECT_EQ(dictionary.decode(encoded[7].data, encoded[7].size, single), messages[7].size());
+    EXPECT_EQ(std::string(single.begin(), single.end()), messages[7]);
+    EXPECT_THROW(dictionary.decode(encoded[7].data, 1, single), std::runtime_error);
+    const uint8_t nineInOneByte[] = {9, 0};
+    EXPECT_THROW(dictionary.decode(nineInOneByte, 2, single), std::runtime_error);
+    const uint8_t overlong[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x02, 0};
+    EXPECT_THROW(dictionary.decode(overlong, sizeof(overlong), single), std::runtime_error);
+}
+
+TEST(MyMap, poolReuse)
+{
+    std::vector<int> keys(3000);
+    for (int i = 0; i < 3000; i++) keys[i] = i * 7919 % 3001;
+    MyMap<int, std::string> map;
+    for (int key : keys) map.insert(key, std::to_string(key));
+    EXPECT_THROW(map.insert(keys[5], "again"), std::invalid_argument);
+
+    //  removing every other key exercises all cases of the fix-up
+    for (size_t i = 0; i < keys.size(); i += 2) map.remove(keys[i]);
+    for (size_t i = 0; i < keys.size(); i++) {
+        EXPECT_EQ(map.has(keys[i]), i % 2 == 1);
+    }
+    EXPECT_EQ(map.get_keys().get_size(), keys.size() / 2);
+    EXPECT_EQ(map.find(keys[1]), std::to_string(keys[1]));
+    EXPECT_THROW(map.remove(keys[0]), std::invalid_argument);
+
+    //  removed and cleared nodes are reused without new slabs
+    for (size_t i = 0; i < keys.size(); i += 2) map.insert(keys[i], "");
+    EXPECT_EQ(map.get_keys().get_size(), keys.size());
+    map.clear();
+    MyMap<int, int> counts;
+    for (int key : keys) counts.insert(key, 1);
+    counts.clear();
+    size_t before = allocationCount;
+    for (int key : keys) counts.insert(key, 2);
+    EXPECT_EQ(allocationCount - before, 0u);
+    EXPECT_EQ(counts.find(keys.back()), 2);
+
+    MyMap<int, int, HeapNodeAllocator<TreeNode<int, int>>> heap = {{1, 10}, {2, 20}, {3, 30}};
+    heap.remove(2);
+    EXPECT_FALSE(heap.has(2));
+    EXPECT_EQ(heap.find(3), 30);
+}
+
+TEST(MyMap, upsertAndLookup)
+{
+    std::string text = "the quick brown fox jumps over the lazy dog";
+    MyMap<char, int> counts;
+    for (char c : text) counts[c]++;
+    EXPECT_EQ(counts.find(' '), 8);
+    EXPECT_EQ(counts.find('o'), 4);
+    EXPECT_EQ(counts.get_keys().get_size(), 27u);
+
+    EXPECT_EQ(counts.lookup('!'), nullptr);
+    ASSERT_NE(counts.lookup('q'), nullptr);
+    *counts.lookup('q') = 5;
+    counts.addToValue('q', 3);
+    counts.addToValue('!', 3);
+    EXPECT_EQ(counts.find('q'), 8);
+    EXPECT_FALSE(counts.has('!'));
+
+    EXPECT_EQ(counts.upsert('q', 1), 1);
+    EXPECT_EQ(counts.upsert('!', 2), 2);
+    const MyMap<char, int>& view = counts;
+    EXPECT_EQ(*view.lookup('!'), 2);
+    EXPECT_EQ(counts.get_keys().get_size(), 28u);
+}
+
+TEST(MyMap, orderedIteration)
+{
+    MyMap<uint64_t, int> events;
+    EXPECT_TRUE(events.begin() == events.end());
+    for (int i = 0; i < 1000; i++) events.insert(1700000000 + uint64_t(i * 7919 % 1000) * 10, i);
+
+    uint64_t previous = 0;
+    size_t count = 0;
+    for (auto [time, id] : events) {
+        EXPECT_LT(previous, time);
+        EXPECT_EQ(id * 7919 % 1000, int(time - 1700000000) / 10);
+        previous = time;
+        count++;
+    }
+    EXPECT_EQ(count, 1000u);
+
+    //  keys from 1700000105 to 1700000200 inclusive
+    auto first = events.lower_bound(1700000105), last = events.upper_bound(1700000200);
+    EXPECT_EQ(first.key(), 1700000110u);
+    EXPECT_EQ(std::distance(first, last), 10);
+    EXPECT_EQ(std::prev(last)->first, 1700000200u);
+    for (auto it = first; it != last; ++it) it->second = -1;
+    EXPECT_EQ(events.find(1700000150), -1);
+
+    const MyMap<uint64_t, int>& view = events;
+    auto range = view.equal_range(1700000150);
+    EXPECT_EQ(std::distance(range.first, range.second), 1);
+    EXPECT_TRUE(view.equal_range(1700000151).first == view.equal_range(1700000151).second);
+    EXPECT_TRUE(view.lower_bound(1800000000) == view.end());
+    EXPECT_EQ((--view.end()).key(), 1700009990u);
+    MyMap<uint64_t, int>::const_iterator converted = events.begin();
+    EXPECT_EQ(converted.key(), 1700000000u);
+
+    events.remove(1700000150);
+    EXPECT_EQ(events.lower_bound(1700000150).key(), 1700000160u);
+}
+
+TEST(MyMap, bulkLoadAndMerge)
+{
+    std::vector<std::pair<int, int>> sorted;
+    for (int i = 0; i < 5000; i++) sorted.push_back({2 * i, i});
+    MyMap<int, int> map(sorted.begin(), sorted.end());
+    EXPECT_EQ(map.get_size(), sorted.size());
+    EXPECT_EQ(map.find(4000), 2000);
+    EXPECT_EQ(map.begin().key(), 0);
+
+    //  a large batch is merged in one pass, a small one key by key
+    std::vector<std::pair<int, int>> batch;
+    for (int i = -1; i < 12000; i += 2) batch.push_back({i, -i});
+    map.mergeSorted(batch.begin(), batch.end());
+    std::vector<std::pair<int, int>> small = {{3, 1}, {10001, 2}};
+    map.mergeSorted(small.begin(), small.end());
+
+    std::map<int, int> expected(sorted.begin(), sorted.end());
+    for (const auto& pair : batch) expected[pair.first] = pair.second;
+    for (const auto& pair : small) expected[pair.first] = pair.second;
+    EXPECT_EQ(map.get_size(), expected.size());
+    auto it = expected.begin();
+    for (auto [key, value] : map) {
+        ASSERT_EQ(key, it->first);
+        EXPECT_EQ(value, it->second);
+        ++it;
+    }
+
+    //  the tree stays usable for single updates
+    map.remove(3);
+    map.insert(3, 30);
+    EXPECT_EQ(map.find(3), 30);
+
+    std::vector<std::pair<int, int>> unsorted = {{1, 0}, {5, 0}, {5, 1}};
+    EXPECT_THROW((MyMap<int, int>(unsorted.begin(), unsorted.end())), std::invalid_argument);
+    EXPECT_THROW(map.mergeSorted(unsorted.begin(), unsorted.end()), std::invalid_argument);
+    EXPECT_EQ(map.find(5), expected[5]);
+}
+
+TEST(BTreeMap, matchesStdMap)
+{
+    //  enough keys for several levels, removed again down to an empty tree
+    BTreeMap<int, int> map;
+    std::map<int, int> expected;
+    std::mt19937 random(3);
+    for (int i = 0; i < 20000; i++) {
+        int key = int(random() % 30000);
+        if (expected.count(key)) {
+            EXPECT_THROW(map.insert(key, i), std::invalid_argument);
+        } else {
+            map.insert(key, i);
+            expected[key] = i;
+        }
+    }
+    for (int i = 0; i < 40000; i++) {
+        int key = int(random() % 30000);
+        ASSERT_EQ(map.has(key), expected.count(key) == 1);
+        if (expected.erase(key)) {
+            map.remove(key);
+        } else {
+            EXPECT_THROW(map.remove(key), std::invalid_argument);
+        }
+        if (i % 4 == 0) {
+            map.upsert(key ^ 1, i);
+            expected[key ^ 1] = i;
+        }
+    }
+    EXPECT_EQ(map.get_size(), expected.size());
+    auto it = expected.begin();
+    for (auto [key, value] : map) {
+        ASSERT_EQ(key, it->first);
+        EXPECT_EQ(value, it->second);
+        ++it;
+    }
+    EXPECT_TRUE(it == expected.end());
+
+    for (const auto& pair : expected) map.remove(pair.first);
+    EXPECT_EQ(map.get_size(), 0u);
+    EXPECT_TRUE(map.begin() == map.end());
+    EXPECT_THROW(map.find(1), std::invalid_argument);
+    map[5] += 2;
+    map.addToValue(5, 3);
+    EXPECT_EQ(map.find(5), 5);
+}
+
+TEST(BTreeMap, orderedIteration)
+{
+    BTreeMap<uint64_t, int> events;
+    for (int i = 0; i < 1000; i++) events.insert(1700000000 + uint64_t(i * 7919 % 1000) * 10, i);
+
+    auto first = events.lower_bound(1700000105), last = events.upper_bound(1700000200);
+    EXPECT_EQ(first.key(), 1700000110u);
+    EXPECT_EQ(std::distance(first, last), 10);
+    EXPECT_EQ(std::prev(last)->first, 1700000200u);
+    for (auto it = first; it != last; ++it) it->second = -1;
+    EXPECT_EQ(*events.lookup(1700000150), -1);
+
+    //  walking backwards crosses leaves as well
+    const BTreeMap<uint64_t, int>& view = events;
+    size_t count = 0;
+    for (auto it = view.end(); it != view.begin(); count++) --it;
+    EXPECT_EQ(count, 1000u);
+    EXPECT_TRUE(view.lower_bound(1800000000) == view.end());
+    EXPECT_EQ((--view.end()).key(), 1700009990u);
+    EXPECT_TRUE(view.equal_range(1700000151).first == view.equal_range(1700000151).second);
+    EXPECT_EQ(view.get_keys().get_size(), 1000u);
+
+    events.clear();
+    EXPECT_EQ(events.lookup(1700000150), nullptr);
+    events.insert(1, 1);
+    EXPECT_EQ(events.begin().value(), 1);
+}